@@ -0,0 +1,61 @@
+# This file is part of RawTherapee.
+#
+# RawTherapee is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# RawTherapee is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+
+# Checks whether the compiler can build the AVX2 and AVX-512 variants of the
+# rtengine kernels which are selected at runtime (see rtengine/simdkernels.h).
+# Sets HAVE_SIMD_DISPATCH_AVX2 and HAVE_SIMD_DISPATCH_AVX512 and the flags to
+# compile them with, SIMD_DISPATCH_AVX2_FLAGS and SIMD_DISPATCH_AVX512_FLAGS.
+
+include(CheckCXXSourceCompiles)
+include(CheckCXXCompilerFlag)
+
+set(CMAKE_REQUIRED_QUIET_COPY "${CMAKE_REQUIRED_QUIET}")
+set(CMAKE_REQUIRED_QUIET ON)
+
+set(TEST_SOURCE
+"
+#if !defined(__x86_64__) && !defined(__i386__)
+#error
+#endif
+
+int main()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports(\"avx2\") && __builtin_cpu_supports(\"fma\") && __builtin_cpu_supports(\"avx512f\");
+}
+")
+
+CHECK_CXX_SOURCE_COMPILES("${TEST_SOURCE}" HAVE_X86_CPU_SUPPORTS)
+
+if(HAVE_X86_CPU_SUPPORTS)
+    set(SIMD_DISPATCH_AVX2_FLAGS "-mavx2 -mfma")
+    set(CMAKE_REQUIRED_FLAGS "${SIMD_DISPATCH_AVX2_FLAGS}")
+    CHECK_CXX_SOURCE_COMPILES("int main() { return 0; }" HAVE_SIMD_DISPATCH_AVX2)
+
+    set(SIMD_DISPATCH_AVX512_FLAGS "-mavx512f -mavx2 -mfma")
+    # gcc and clang split 512 bit loops into 256 bit ones by default
+    CHECK_CXX_COMPILER_FLAG("-mprefer-vector-width=512" HAVE_PREFER_VECTOR_WIDTH)
+    if(HAVE_PREFER_VECTOR_WIDTH)
+        set(SIMD_DISPATCH_AVX512_FLAGS "${SIMD_DISPATCH_AVX512_FLAGS} -mprefer-vector-width=512")
+    endif()
+    set(CMAKE_REQUIRED_FLAGS "${SIMD_DISPATCH_AVX512_FLAGS}")
+    CHECK_CXX_SOURCE_COMPILES("int main() { return 0; }" HAVE_SIMD_DISPATCH_AVX512)
+    unset(CMAKE_REQUIRED_FLAGS)
+endif()
+
+unset(TEST_SOURCE)
+
+set(CMAKE_REQUIRED_QUIET "${CMAKE_REQUIRED_QUIET_COPY}")
+unset(CMAKE_REQUIRED_QUIET_COPY)
@@ -22,12 +22,20 @@
 //
 ////////////////////////////////////////////////////////////////
 
+#include <cstring>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include "rtengine.h"
 #include "rawimagesource.h"
+#include "rt_algo.h"
 #include "rt_math.h"
 #include "gauss.h"
 #include "median.h"
 #include "StopWatch.h"
+#include "../rtgui/threadutils.h"
 
 namespace
 {
@@ -112,6 +120,51 @@ bool LinEqSolve(int nDim, double* pfMatr, double* pfVect, double* pfSolution)
     return true;
 }
 //end of linear equation solver
+
+struct CaFit {
+    int polyord;
+    double params[2][2][16];
+};
+
+// The fitted polynomials of the last auto CA corrections, one per iteration. The fit depends only on the raw data
+// and the parameters in the key, so refreshing the editor or exporting an image which was corrected before can
+// skip the estimation passes.
+class CaFitCache
+{
+public:
+    bool get(const std::string& key, std::vector<CaFit>& fits)
+    {
+        MyMutex::MyLock lock(mutex);
+
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->first == key) {
+                fits = it->second;
+                entries.splice(entries.begin(), entries, it); // most recently used first
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void put(const std::string& key, const std::vector<CaFit>& fits)
+    {
+        MyMutex::MyLock lock(mutex);
+
+        entries.emplace_front(key, fits);
+
+        if (entries.size() > maxEntries) {
+            entries.pop_back();
+        }
+    }
+
+private:
+    static constexpr size_t maxEntries = 16;
+    MyMutex mutex;
+    std::list<std::pair<std::string, std::vector<CaFit>>> entries;
+};
+
+CaFitCache caFitCache;
 }
 
 using namespace std;
@@ -228,6 +281,18 @@ float* RawImageSource::CA_correct_RT(
         }
     }
 
+    // the estimation passes are skipped if the same data was corrected before
+    std::string fitCacheKey;
+    std::vector<CaFit> fits;
+
+    if (autoCA && !fitParamsSet) {
+        std::ostringstream key;
+        key << W << ' ' << H << ' ' << iterations << ' ' << avoidColourshift << ' ' << std::hex << hashPlane(rawData, W, H);
+        fitCacheKey = key.str();
+    }
+
+    const bool fitsCached = !fitCacheKey.empty() && caFitCache.get(fitCacheKey, fits);
+
     for (size_t it = 0; it < iterations && processpasstwo; ++it) {
         float blockave[2][2] = {};
         float blocksqave[2][2] = {};
@@ -237,6 +302,13 @@ float* RawImageSource::CA_correct_RT(
         //order of 2d polynomial fit (polyord), and numpar=polyord^2
         int polyord = 4, numpar = 16;
 
+        const bool useStoredFit = fitParamsSet || fitsCached;
+
+        if (fitsCached) {
+            polyord = fits[it].polyord;
+            memcpy(fitparams, fits[it].params, sizeof(fitparams));
+        }
+
         constexpr float eps = 1e-5f, eps2 = 1e-10f; //tolerance to avoid dividing by zero
 
 #ifdef _OPENMP
@@ -257,7 +329,7 @@ float* RawImageSource::CA_correct_RT(
             // assign working space
             constexpr int buffersize = sizeof(float) * ts * ts + 8 * sizeof(float) * ts * tsh + 8 * 64 + 63;
             constexpr int buffersizePassTwo = sizeof(float) * ts * ts + 4 * sizeof(float) * ts * tsh + 4 * 64 + 63;
-            char * const bufferThr = (char *) malloc((autoCA && !fitParamsSet) ? buffersize : buffersizePassTwo);
+            char * const bufferThr = (char *) malloc((autoCA && !useStoredFit) ? buffersize : buffersizePassTwo);
 
             char * const data = (char*)((uintptr_t(bufferThr) + uintptr_t(63)) / 64 * 64);
 
@@ -269,7 +341,7 @@ float* RawImageSource::CA_correct_RT(
             rgb[1] = (float*) (data + sizeof(float) * ts * tsh + 1 * 64);
             rgb[2] = (float*) (data + sizeof(float) * (ts * ts + ts * tsh) + 2 * 64);
 
-            if (autoCA && !fitParamsSet) {
+            if (autoCA && !useStoredFit) {
                 constexpr float caAutostrength = 8.f;
                 //high pass filter for R/B in vertical direction
                 float* rbhpfh  = (float*) (data + 2 * sizeof(float) * ts * ts + 3 * 64);
@@ -999,7 +1071,7 @@ float* RawImageSource::CA_correct_RT(
                         }
                         //end of border fill
 
-                        if (!autoCA || fitParamsIn) {
+                        if (!autoCA || fitParamsIn || useStoredFit) {
 #ifdef __SSE2__
                             const vfloat onev = F2V(1.f);
                             const vfloat epsv = F2V(eps);
@@ -1271,6 +1343,13 @@ float* RawImageSource::CA_correct_RT(
             // clean up
             free(bufferThr);
         }
+
+        if (!fitCacheKey.empty() && !fitsCached && processpasstwo) {
+            fits.emplace_back();
+            fits.back().polyord = polyord;
+            memcpy(fits.back().params, fitparams, sizeof(fitparams));
+        }
+
         if (avoidColourshift) {
             // to avoid or at least reduce the colour shift caused by raw ca correction we compute the per pixel difference factors
             // of red and blue channel and apply a gaussian blur to them.
@@ -1352,6 +1431,10 @@ float* RawImageSource::CA_correct_RT(
         }
     }
 
+    if (!fitCacheKey.empty() && !fitsCached && processpasstwo && fits.size() == iterations) {
+        caFitCache.put(fitCacheKey, fits);
+    }
+
     if (autoCA && fitParamsTransfer && fitParamsOut) {
         // store calculated parameters
         int index = 0;
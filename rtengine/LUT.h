@@ -632,6 +632,12 @@ public:
 
     // share the buffer with another LUT, handy for same data but different clip flags
     void share(const LUT<T> &source, int flags = LUT_CLIP_BELOW | LUT_CLIP_ABOVE)
+    {
+        wrap(source.data, source.getSize(), flags);
+    }
+
+    // use an external buffer of s + 3 elements (see comment in constructor), which is not freed by the LUT
+    void wrap(T* source, unsigned int s, int flags = LUT_CLIP_BELOW | LUT_CLIP_ABOVE)
     {
         if (owner && data) {
             delete[] data;
@@ -639,9 +645,9 @@ public:
 
         dirty = false;  // Assumption
         clip = flags;
-        data = source.data;
+        data = source;
         owner = 0;
-        size = source.getSize();
+        size = s;
         upperBound = size - 1;
         maxs = size - 2;
         maxsf = (float)maxs;
@@ -22,6 +22,8 @@
 #include <cstdlib>
 #include <utility>
 
+#include "bufferpool.h"
+
 inline size_t padToAlignment(size_t size, size_t align = 16) {
     return align * ((size + align - 1) / align);
 }
@@ -53,9 +55,7 @@ public:
 
     ~AlignedBuffer ()
     {
-        if (real) {
-            free(real);
-        }
+        rtengine::releaseBuffer(real, allocatedSize + alignment);
     }
 
     /** @brief Return true if there's no memory allocated
@@ -75,9 +75,7 @@ public:
         if (allocatedSize != size) {
             if (!size) {
                 // The user want to free the memory
-                if (real) {
-                    free(real);
-                }
+                rtengine::releaseBuffer(real, allocatedSize + alignment);
 
                 real = nullptr;
                 data = nullptr;
@@ -89,27 +87,10 @@ public:
                 size_t oldAllocatedSize = allocatedSize;
                 allocatedSize = size * unitSize;
 
-                // realloc were used here to limit memory fragmentation, specially when the size was smaller than the previous one.
-                // But realloc copies the content to the eventually new location, which is unnecessary. To avoid this performance penalty,
-                // we're freeing the memory and allocate it again if the new size is bigger.
-
-                if (allocatedSize < oldAllocatedSize) {
-                    void *temp = realloc(real, allocatedSize + alignment);
-                    if (temp) { // realloc succeeded
-                        real = temp;
-                    } else { // realloc failed => free old buffer and allocate new one
-                        if (real) {
-                            free (real);
-                        }
-                        real = malloc(allocatedSize + alignment);
-                    }
-                } else {
-                    if (real) {
-                        free (real);
-                    }
-
-                    real = malloc(allocatedSize + alignment);
-                }
+                // The buffers come from the pool, which hands out a kept buffer of the same size class without touching
+                // the memory. realloc would copy the content, which is unnecessary, so the buffer is simply exchanged.
+                rtengine::releaseBuffer(real, oldAllocatedSize + alignment);
+                real = rtengine::acquireBuffer(allocatedSize + alignment);
 
                 if (real) {
                     data = (T*)( ( uintptr_t(real) + uintptr_t(alignment - 1)) / alignment * alignment);
@@ -56,6 +56,7 @@
 #include <cstring>
 #include <sys/types.h>
 #include <vector>
+#include "bufferpool.h"
 #include "noncopyable.h"
 
 // flags for use
@@ -70,7 +71,7 @@ class array2D
 private:
     ssize_t width;
     std::vector<T*> rows;
-    std::vector<T> buffer;
+    std::vector<T, rtengine::PooledAllocator<T>> buffer;
 
     void initRows(ssize_t h, int offset = 0)
     {
@@ -174,9 +175,10 @@ public:
         }
     }
 
+    // gives the memory back to the buffer pool
     void free()
     {
-        buffer.clear();
+        decltype(buffer)().swap(buffer);
         rows.clear();
         width = 0;
     }
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////
+//
+//  Binned demosaic for bayer and x-trans sensors, intended use is for previews at scale >= 2
+//
+//  Each block of 2x2 (bayer) or 3x3 (x-trans) pixels gets the average of the red, green and blue pixels of the block.
+//  This is about as fast as copying the raw data and gives the same detail as a full demosaic at half or third of
+//  the resolution, which is all a downscaled preview shows.
+//
+//  binned_demosaic.cc is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+////////////////////////////////////////////////////////////////
+
+#include "rawimage.h"
+#include "rawimagesource.h"
+#include "rt_math.h"
+
+using namespace rtengine;
+
+void RawImageSource::binned_demosaic(const array2D<float> &rawData, array2D<float> &red, array2D<float> &green, array2D<float> &blue)
+{
+    const bool isBayer = ri->getSensorType() == ST_BAYER;
+
+    if (isBayer) {
+        // Test for RGB cfa
+        for (int i = 0; i < 2; i++) {
+            for (int j = 0; j < 2; j++) {
+                if (FC(i, j) == 3) {
+                    fast_demosaic();
+                    return;
+                }
+            }
+        }
+    }
+
+    // every 2x2 block of a bayer sensor and every 3x3 block of a x-trans sensor has pixels of all three colours
+    const int blockSize = isBayer ? 2 : 3;
+
+    if (W < blockSize || H < blockSize) {
+        if (isBayer) {
+            fast_demosaic();
+        } else {
+            fast_xtrans_interpolate(rawData, red, green, blue);
+        }
+        return;
+    }
+
+    float** const rgb[3] = {red, green, blue};
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for (int row = 0; row < H; row += blockSize) {
+        const int rowEnd = std::min(row + blockSize, H);
+        // the last block may be cut, it gets the values of the last full block
+        const int blockRow = std::min(row, H - blockSize);
+
+        for (int col = 0; col < W; col += blockSize) {
+            const int colEnd = std::min(col + blockSize, W);
+            const int blockCol = std::min(col, W - blockSize);
+
+            float sum[3] = {};
+            int count[3] = {};
+
+            for (int i = blockRow; i < blockRow + blockSize; ++i) {
+                for (int j = blockCol; j < blockCol + blockSize; ++j) {
+                    const int c = isBayer ? FC(i, j) : ri->XTRANSFC(i, j);
+                    sum[c] += rawData[i][j];
+                    ++count[c];
+                }
+            }
+
+            for (int c = 0; c < 3; ++c) {
+                const float val = sum[c] / count[c];
+
+                for (int i = row; i < rowEnd; ++i) {
+                    for (int j = col; j < colEnd; ++j) {
+                        rgb[c][i][j] = val;
+                    }
+                }
+            }
+        }
+    }
+}
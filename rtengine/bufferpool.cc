@@ -0,0 +1,179 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstdlib>
+#include <list>
+#include <utility>
+
+#include "bufferpool.h"
+#include "noncopyable.h"
+#include "../rtgui/threadutils.h"
+
+namespace
+{
+
+// smaller buffers are cheap to get from malloc()
+constexpr std::size_t minPooledSize = 1 << 20;
+
+std::size_t getSizeClass(std::size_t size)
+{
+    // the step is 1/8 of the largest power of two not above size
+    std::size_t step = minPooledSize / 8;
+
+    while (step * 16 <= size) {
+        step *= 2;
+    }
+
+    return (size + step - 1) / step * step;
+}
+
+class BufferPool final :
+    public rtengine::NonCopyable
+{
+public:
+    BufferPool() :
+        capacity(0),
+        bytes(0),
+        hits(0),
+        misses(0)
+    {
+    }
+
+    void* acquire(std::size_t size)
+    {
+        if (size < minPooledSize) {
+            return malloc(size);
+        }
+
+        size = getSizeClass(size);
+
+        {
+            MyMutex::MyLock lock(mutex);
+
+            for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+                if (it->first == size) {
+                    void* const buffer = it->second;
+                    buffers.erase(it);
+                    bytes -= size;
+                    ++hits;
+                    return buffer;
+                }
+            }
+
+            ++misses;
+        }
+
+        return malloc(size);
+    }
+
+    void release(void* buffer, std::size_t size, bool keep)
+    {
+        if (!buffer) {
+            return;
+        }
+
+        if (keep && size >= minPooledSize) {
+            size = getSizeClass(size);
+            MyMutex::MyLock lock(mutex);
+
+            if (size <= capacity) {
+                trim(capacity - size);
+                // the most recently used buffers are in front, the oldest are dropped first
+                buffers.emplace_front(size, buffer);
+                bytes += size;
+                return;
+            }
+        }
+
+        free(buffer);
+    }
+
+    void setCapacity(std::size_t newCapacity)
+    {
+        MyMutex::MyLock lock(mutex);
+        capacity = newCapacity;
+        trim(capacity);
+    }
+
+    void trimAll()
+    {
+        MyMutex::MyLock lock(mutex);
+        trim(0);
+    }
+
+    rtengine::BufferPoolStatistics getStatistics() const
+    {
+        MyMutex::MyLock lock(mutex);
+        return {hits, misses, buffers.size(), bytes};
+    }
+
+private:
+    // frees the oldest buffers until at most maxBytes are kept, mutex has to be locked
+    void trim(std::size_t maxBytes)
+    {
+        while (bytes > maxBytes) {
+            free(buffers.back().second);
+            bytes -= buffers.back().first;
+            buffers.pop_back();
+        }
+    }
+
+    mutable MyMutex mutex;
+    std::list<std::pair<std::size_t, void*>> buffers;
+    std::size_t capacity;
+    std::size_t bytes;
+    std::size_t hits;
+    std::size_t misses;
+};
+
+BufferPool& getPool()
+{
+    // never destroyed, static image containers can release their buffers after the end of main()
+    static BufferPool* const pool = new BufferPool;
+    return *pool;
+}
+
+}
+
+namespace rtengine
+{
+
+void* acquireBuffer(std::size_t size)
+{
+    return getPool().acquire(size);
+}
+
+void releaseBuffer(void* buffer, std::size_t size, bool keep)
+{
+    getPool().release(buffer, size, keep);
+}
+
+void setBufferPoolCapacity(std::size_t capacity)
+{
+    getPool().setCapacity(capacity);
+}
+
+void trimBufferPool()
+{
+    getPool().trimAll();
+}
+
+BufferPoolStatistics getBufferPoolStatistics()
+{
+    return getPool().getStatistics();
+}
+
+}
@@ -0,0 +1,92 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+/*
+ *  Pool of the buffers of the image containers (Imagefloat, Image16, Image8, LabImage, array2D)
+ *
+ *  The editor and the batch processing allocate and free buffers of the same sizes over and over. Freed buffers
+ *  larger than 1 MiB are kept up to a configurable total size and handed out again, instead of being returned
+ *  to the system and page faulted in again on the next allocation. Buffers are grouped in size classes of 1/8
+ *  of a power of two, so a buffer is at most 12.5% larger than requested.
+ */
+namespace rtengine
+{
+
+struct BufferPoolStatistics {
+    std::size_t hits;        // allocations served by the pool
+    std::size_t misses;      // allocations of pooled sizes which had to use malloc()
+    std::size_t buffers;     // number of buffers kept by the pool
+    std::size_t bytes;       // total size of the buffers kept by the pool
+};
+
+// Allocates a buffer of at least size bytes with the alignment of malloc(), returns nullptr on failure
+void* acquireBuffer(std::size_t size);
+// Gives back a buffer allocated by acquireBuffer(size), size has to be the same.
+// Buffers freed on purpose to lower the peak memory use are passed with keep = false and go back to the system.
+void releaseBuffer(void* buffer, std::size_t size, bool keep = true);
+// Maximum total size of the kept buffers in bytes, 0 disables the pool. Initially 0.
+void setBufferPoolCapacity(std::size_t capacity);
+// Gives all kept buffers back to the system, the capacity stays unchanged
+void trimBufferPool();
+BufferPoolStatistics getBufferPoolStatistics();
+
+// std::allocator replacement for the std::vector based containers
+template<typename T>
+class PooledAllocator
+{
+public:
+    using value_type = T;
+
+    PooledAllocator() = default;
+
+    template<typename U>
+    PooledAllocator(const PooledAllocator<U>&) {}
+
+    T* allocate(std::size_t n)
+    {
+        T* const buffer = static_cast<T*>(acquireBuffer(n * sizeof(T)));
+
+        if (!buffer) {
+            throw std::bad_alloc();
+        }
+
+        return buffer;
+    }
+
+    void deallocate(T* buffer, std::size_t n)
+    {
+        releaseBuffer(buffer, n * sizeof(T));
+    }
+};
+
+template<typename T, typename U>
+bool operator ==(const PooledAllocator<T>&, const PooledAllocator<U>&)
+{
+    return true;
+}
+
+template<typename T, typename U>
+bool operator !=(const PooledAllocator<T>&, const PooledAllocator<U>&)
+{
+    return false;
+}
+
+}
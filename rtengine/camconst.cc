@@ -597,7 +597,7 @@ void CameraConst::update_globalGreenEquilibration(bool other)
     globalGreenEquilibration = (other ? 1 : 0);
 }
 
-bool CameraConstantsStore::parse_camera_constants_file(const Glib::ustring& filename_)
+bool CameraConstantsStore::parse_camera_constants_file(const Glib::ustring& filename_) const
 {
     // read the file into a single long string
     const char *filename = filename_.c_str();
@@ -748,7 +748,8 @@ parse_error:
     return false;
 }
 
-CameraConstantsStore::CameraConstantsStore()
+CameraConstantsStore::CameraConstantsStore() :
+    loaded(true)
 {
 }
 
@@ -762,6 +763,23 @@ CameraConstantsStore::~CameraConstantsStore()
 
 void CameraConstantsStore::init(const Glib::ustring& baseDir, const Glib::ustring& userSettingsDir)
 {
+    MyMutex::MyLock lock(loadMutex);
+
+    this->baseDir = baseDir;
+    this->userSettingsDir = userSettingsDir;
+    loaded = false;
+}
+
+void CameraConstantsStore::load() const
+{
+    MyMutex::MyLock lock(loadMutex);
+
+    if (loaded) {
+        return;
+    }
+
+    loaded = true;
+
     parse_camera_constants_file(Glib::build_filename(baseDir, "camconst.json"));
 
     const Glib::ustring userFile(Glib::build_filename(userSettingsDir, "camconst.json"));
@@ -779,6 +797,8 @@ CameraConstantsStore* CameraConstantsStore::getInstance()
 
 const CameraConst* CameraConstantsStore::get(const char make[], const char model[]) const
 {
+    load();
+
     std::string key(make);
     key += " ";
     key += model;
@@ -7,6 +7,8 @@
 #include <string>
 #include <vector>
 
+#include "../rtgui/threadutils.h"
+
 namespace Glib
 {
 
@@ -65,10 +67,16 @@ public:
 class CameraConstantsStore final
 {
 private:
-    std::map<std::string, CameraConst *> mCameraConstants;
+    // the files are parsed on the first call of get(), jobs without raw files don't need them
+    mutable std::map<std::string, CameraConst *> mCameraConstants;
+    std::string baseDir;
+    std::string userSettingsDir;
+    mutable bool loaded;
+    mutable MyMutex loadMutex;
 
     CameraConstantsStore();
-    bool parse_camera_constants_file(const Glib::ustring& filename);
+    bool parse_camera_constants_file(const Glib::ustring& filename) const;
+    void load() const;
 
 public:
     ~CameraConstantsStore();
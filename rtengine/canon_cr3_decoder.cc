@@ -60,13 +60,22 @@ it under the terms of the one of two licenses as you choose:
 #include <algorithm>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <iostream>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "dcraw.h"
 
+#include "mytime.h"
 #include "rt_math.h"
 
+// With -DWITH_BENCHMARK=ON (which defines BENCHMARK) every CR3 decode reports its throughput on stdout
+
 void DCraw::parse_canon_cr3()
 {
     strncpy(make, "Canon", sizeof(make));
@@ -689,7 +698,11 @@ struct LibRaw_abstract_datastream {
 };
 
 struct CrxBitstream {
+#ifdef MYFILE_MMAP
+    std::uint8_t* mdatBuf; // points into the mapped file
+#else
     std::uint8_t mdatBuf[CRX_BUF_SIZE];
+#endif
     std::uint64_t mdatSize;
     std::uint64_t curBufOffset;
     std::uint32_t curPos;
@@ -829,6 +842,18 @@ inline void crxFillBuffer(CrxBitstream* bitStrm)
     if (bitStrm->curPos >= bitStrm->curBufSize && bitStrm->mdatSize) {
         bitStrm->curPos = 0;
         bitStrm->curBufOffset += bitStrm->curBufSize;
+#ifdef MYFILE_MMAP
+        // no copy and no lock shared with the streams decoded by the other threads
+        IMFILE* const ifp = bitStrm->input->ifp;
+
+        if (bitStrm->curBufOffset >= static_cast<std::uint64_t>(ifp->size)) {
+            throw std::runtime_error("Unexpected end of file in CRX bitstream");
+        }
+
+        bitStrm->mdatBuf = fdata(bitStrm->curBufOffset, ifp);
+        bitStrm->curBufSize = std::min({bitStrm->mdatSize, CRX_BUF_SIZE, static_cast<std::uint64_t>(ifp->size) - bitStrm->curBufOffset});
+        bitStrm->mdatSize -= bitStrm->curBufSize;
+#else
 #ifdef _OPENMP
         #pragma omp critical
 #endif
@@ -848,9 +873,25 @@ inline void crxFillBuffer(CrxBitstream* bitStrm)
 
             bitStrm->mdatSize -= bitStrm->curBufSize;
         }
+#endif
     }
 }
 
+// Reads the next 4 bytes of the current buffer as a big endian word. Returns false if less than 4 bytes are left,
+// the buffer can end anywhere in the mapped file and must not be read past curBufSize.
+inline bool crxBitstreamGetWord(CrxBitstream* bitStrm, std::uint32_t& word)
+{
+    if (bitStrm->curBufSize < 4 || bitStrm->curPos > bitStrm->curBufSize - 4) {
+        return false;
+    }
+
+    memcpy(&word, bitStrm->mdatBuf + bitStrm->curPos, sizeof(word));
+    word = _byteswap_ulong(word);
+    bitStrm->curPos += 4;
+    crxFillBuffer(bitStrm);
+    return true;
+}
+
 inline int crxBitstreamGetZeros(CrxBitstream* bitStrm)
 {
 //  std::uint32_t bitData = bitStrm->bitData;
@@ -867,10 +908,10 @@ inline int crxBitstreamGetZeros(CrxBitstream* bitStrm)
         std::uint32_t bitsLeft = bitStrm->bitsLeft;
 
         while (true) {
-            while (bitStrm->curPos + 4 <= bitStrm->curBufSize) {
-                nextData = _byteswap_ulong(*reinterpret_cast<std::uint32_t*>(bitStrm->mdatBuf + bitStrm->curPos));
-                bitStrm->curPos += 4;
-                crxFillBuffer(bitStrm);
+            std::uint32_t word;
+
+            while (crxBitstreamGetWord(bitStrm, word)) {
+                nextData = word;
 
                 if (nextData) {
                     _BitScanReverse(&nonZeroBit, static_cast<std::uint32_t>(nextData));
@@ -916,10 +957,7 @@ inline std::uint32_t crxBitstreamGetBits(CrxBitstream* bitStrm, int bits)
 
     if (bitsLeft < bits) {
         // get them from stream
-        if (bitStrm->curPos + 4 <= bitStrm->curBufSize) {
-            nextWord = _byteswap_ulong(*reinterpret_cast<std::uint32_t*>(bitStrm->mdatBuf + bitStrm->curPos));
-            bitStrm->curPos += 4;
-            crxFillBuffer(bitStrm);
+        if (crxBitstreamGetWord(bitStrm, nextWord)) {
             bitStrm->bitsLeft = 32 - (bits - bitsLeft);
             result = ((nextWord >> bitsLeft) | bitData) >> (32 - bits);
             bitStrm->bitData = nextWord << (bits - bitsLeft);
@@ -2566,60 +2604,51 @@ bool crxSetupSubbandData(
 
 } // namespace
 
-bool DCraw::crxDecodePlane(void* p, std::uint32_t planeNumber)
+bool DCraw::crxDecodeTile(void* p, std::uint32_t planeNumber, int tileNumber, int imageRow, int imageCol)
 {
     CrxImage* const img = static_cast<CrxImage*>(p);
-    int imageRow = 0;
+    const CrxTile* const tile = img->tiles + tileNumber;
+    CrxPlaneComp* const planeComp = tile->comps + planeNumber;
+    const std::uint64_t tileMdatOffset = tile->dataOffset + planeComp->dataOffset;
 
-    for (int tRow = 0; tRow < img->tileRows; ++tRow) {
-        int imageCol = 0;
+    // decode single tile
+    if (!crxSetupSubbandData(img, planeComp, tile, tileMdatOffset)) {
+        return false;
+    }
 
-        for (int tCol = 0; tCol < img->tileCols; ++tCol) {
-            const CrxTile* const tile = img->tiles + tRow * img->tileRows + tCol;
-            CrxPlaneComp* const planeComp = tile->comps + planeNumber;
-            const std::uint64_t tileMdatOffset = tile->dataOffset + planeComp->dataOffset;
+    if (img->levels) {
+        if (!crxIdwt53FilterInitialize(planeComp, img->levels - 1)) {
+            return false;
+        }
 
-            // decode single tile
-            if (!crxSetupSubbandData(img, planeComp, tile, tileMdatOffset)) {
+        for (int i = 0; i < tile->height; ++i) {
+            if (!crxIdwt53FilterDecode(planeComp, img->levels - 1) || !crxIdwt53FilterTransform(planeComp, img->levels - 1)) {
                 return false;
             }
 
-            if (img->levels) {
-                if (!crxIdwt53FilterInitialize(planeComp, img->levels - 1)) {
-                    return false;
-                }
-
-                for (int i = 0; i < tile->height; ++i) {
-                    if (!crxIdwt53FilterDecode(planeComp, img->levels - 1) || !crxIdwt53FilterTransform(planeComp, img->levels - 1)) {
-                        return false;
-                    }
-
-                    const std::int32_t* const lineData = crxIdwt53FilterGetLine(planeComp, img->levels - 1);
-                    crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
-                }
-            } else {
-                // we have the only subband in this case
-                if (!planeComp->subBands->dataSize) {
-                    memset(planeComp->subBands->bandBuf, 0, planeComp->subBands->bandSize);
-                    return true;
-                }
-
-                for (int i = 0; i < tile->height; ++i) {
-                    if (!crxDecodeLine(planeComp->subBands->bandParam, planeComp->subBands->bandBuf)) {
-                        return false;
-                    }
+            const std::int32_t* const lineData = crxIdwt53FilterGetLine(planeComp, img->levels - 1);
+            crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
+        }
+    } else {
+        // we have the only subband in this case
+        if (!planeComp->subBands->dataSize) {
+            memset(planeComp->subBands->bandBuf, 0, planeComp->subBands->bandSize);
+            return true;
+        }
 
-                    const std::int32_t* const lineData = reinterpret_cast<std::int32_t*>(planeComp->subBands->bandBuf);
-                    crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
-                }
+        for (int i = 0; i < tile->height; ++i) {
+            if (!crxDecodeLine(planeComp->subBands->bandParam, planeComp->subBands->bandBuf)) {
+                return false;
             }
 
-            imageCol += tile->width;
+            const std::int32_t* const lineData = reinterpret_cast<std::int32_t*>(planeComp->subBands->bandBuf);
+            crxConvertPlaneLine(img, imageRow + i, imageCol, planeNumber, lineData, tile->width);
         }
-
-        imageRow += img->tiles[tRow * img->tileRows].height;
     }
 
+    // the tile is done, release its buffers right away instead of holding those of the whole image
+    crxFreeSubbandData(img, planeComp);
+
     return true;
 }
 
@@ -3068,31 +3097,106 @@ void crxFreeImageData(CrxImage* img)
 
 }   // namespace
 
-void DCraw::crxLoadDecodeLoop(void* img, int nPlanes)
+void DCraw::crxLoadDecodeLoop(void* p, int nPlanes)
 {
-#ifdef _OPENMP
-    bool results[4]; // nPlanes is always <= 4
-    #pragma omp parallel for
+    CrxImage* const img = static_cast<CrxImage*>(p);
+    const int nTiles = img->tileRows * img->tileCols;
 
-    for (std::int32_t plane = 0; plane < nPlanes; ++plane) {
-        results[plane] = crxDecodePlane(img, plane);
-    }
+    // Every tile of every plane is a separate entropy coded stream with its own
+    // bitstream state, so all of them can be decoded concurrently.
+    std::vector<int> tileRow(nTiles);
+    std::vector<int> tileCol(nTiles);
 
-    for (std::int32_t plane = 0; plane < nPlanes; ++plane) {
-        if (!results[plane]) {
-            derror();
+    for (int tRow = 0, imageRow = 0; tRow < img->tileRows; ++tRow) {
+        for (int tCol = 0, imageCol = 0; tCol < img->tileCols; ++tCol) {
+            const int tileNumber = tRow * img->tileCols + tCol;
+            tileRow[tileNumber] = imageRow;
+            tileCol[tileNumber] = imageCol;
+            imageCol += img->tiles[tileNumber].width;
         }
+
+        imageRow += img->tiles[tRow * img->tileCols].height;
     }
 
+    bool failed = false;
+
+#ifdef BENCHMARK
+#ifdef _OPENMP
+    const int threads = omp_get_max_threads();
+#else
+    const int threads = 1;
+#endif
+    // compressed bytes and decoding time in us of each thread
+    std::vector<std::uint64_t> threadBytes(threads);
+    std::vector<std::int64_t> threadTime(threads);
+    MyTime startTime;
+    startTime.set();
+#endif
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) reduction(||:failed)
+#endif
+
+    for (int task = 0; task < nPlanes * nTiles; ++task) {
+        const int plane = task % nPlanes;
+        const int tileNumber = task / nPlanes;
+#ifdef BENCHMARK
+        MyTime taskStart;
+        taskStart.set();
+#endif
+
+        try {
+            if (!crxDecodeTile(img, plane, tileNumber, tileRow[tileNumber], tileCol[tileNumber])) {
+                failed = true;
+            }
+        } catch (const std::exception&) {
+            // exceptions must not leave the parallel region
+            failed = true;
+        }
+
+#ifdef BENCHMARK
+        MyTime taskStop;
+        taskStop.set();
+#ifdef _OPENMP
+        const int thread = omp_get_thread_num();
 #else
+        const int thread = 0;
+#endif
+        threadBytes[thread] += img->tiles[tileNumber].comps[plane].compSize;
+        threadTime[thread] += taskStop.etime(taskStart);
+#endif
+    }
+
+#ifdef BENCHMARK
+    MyTime stopTime;
+    stopTime.set();
+    std::uint64_t compressedSize = 0;
+    double minThreadRate = 0.0;
+    double maxThreadRate = 0.0;
+    int busyThreads = 0;
 
-    for (std::int32_t plane = 0; plane < nPlanes; ++plane) {
-        if (!crxDecodePlane(img, plane)) {
-            derror();
+    for (int thread = 0; thread < threads; ++thread) {
+        compressedSize += threadBytes[thread];
+
+        if (threadTime[thread] > 0) {
+            // throughput of the thread while it was decoding
+            const double rate = threadBytes[thread] / (threadTime[thread] / 1000000.0) / (1024.0 * 1024.0);
+            minThreadRate = busyThreads ? std::min(minThreadRate, rate) : rate;
+            maxThreadRate = std::max(maxThreadRate, rate);
+            ++busyThreads;
         }
     }
 
+    const double seconds = std::max(stopTime.etime(startTime), 1) / 1000000.0;
+    std::cout << "CR3 decode: " << nPlanes << " planes x " << nTiles << " tiles, "
+              << compressedSize / (1024.0 * 1024.0) << " MB in " << seconds * 1000.0 << " ms, "
+              << compressedSize / seconds / (1024.0 * 1024.0) << " MB/s, "
+              << minThreadRate << "-" << maxThreadRate << " MB/s per thread (" << busyThreads << " threads)" << std::endl;
 #endif
+
+    if (failed) {
+        derror();
+    }
 }
 
 void DCraw::crxConvertPlaneLineDf(void* p, int imageRow)
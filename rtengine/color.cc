@@ -16,6 +16,17 @@
 *  You should have received a copy of the GNU General Public License
 *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
 */
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glibmm/miscutils.h>
 #include <glibmm/ustring.h>
 
 #include "rtengine.h"
@@ -24,6 +35,10 @@
 #include "sleef.h"
 #include "opthelper.h"
 #include "iccstore.h"
+#include "simdkernels.h"
+#include "utils.h"
+#include "settings.h"
+#include "../rtgui/options.h"
 
 using namespace std;
 
@@ -102,7 +117,195 @@ LUTf Color::_10GY30, Color::_10GY40, Color::_10GY50, Color::_10GY60, Color::_10G
 LUTf Color::_75GY30, Color::_75GY40, Color::_75GY50, Color::_75GY60, Color::_75GY70, Color::_75GY80;
 LUTf Color::_5GY30, Color::_5GY40, Color::_5GY50, Color::_5GY60, Color::_5GY70, Color::_5GY80;
 
+namespace
+{
+
+// Bump the version in the magic when the computation of one of the cached tables changes
+constexpr char colorTablesMagic[8] = {'R', 'T', 'C', 'T', 'B', '0', '0', '2'};
+
+GMappedFile* colorTablesFile = nullptr;
+
+Glib::ustring getColorTablesFileName()
+{
+    if (options.cacheBaseDir.empty()) {
+        return Glib::ustring();
+    }
+
+    // the denoise gamma tables depend on a setting, each build gets its own file
+    char buildHash[17];
+    snprintf(buildHash, sizeof(buildHash), "%016llx", static_cast<unsigned long long>(std::hash<std::string>()(getBuildId())));
+    return Glib::build_filename(options.cacheBaseDir, "colortables" + std::to_string(settings->denoiselabgamma) + "-" + buildHash + ".bin");
+}
+
+// The file starts with the magic, the denoise gamma and the number of tables, followed by the length and the text of the build id.
+// Each table is stored as a header of size and clip flags, followed by the values and the 3 extra elements of a LUT.
+// Everything is padded to 16 bytes, so the mapped tables are aligned like allocated ones.
+std::size_t getPaddedSize(std::size_t size)
+{
+    return (size + 15) / 16 * 16;
+}
+
+template<typename T>
+bool writeTable(FILE* f, const LUT<T>& lut)
+{
+    const std::int32_t header[4] = {static_cast<std::int32_t>(lut.getSize()), lut.getClip(), 0, 0};
+    const std::size_t size = lut.getSize() * sizeof(T);
+    const char padding[32] = {};
+
+    return fwrite(header, sizeof(header), 1, f) == 1 && fwrite(&lut[0], size, 1, f) == 1
+           && fwrite(padding, getPaddedSize(size + 3 * sizeof(T)) - size, 1, f) == 1;
+}
+
+template<typename T>
+bool mapTable(const char*& pos, const char* end, LUT<T>& lut)
+{
+    std::int32_t header[4];
+
+    if (static_cast<std::size_t>(end - pos) < sizeof(header)) {
+        return false;
+    }
+
+    memcpy(header, pos, sizeof(header));
+    pos += sizeof(header);
+
+    if (header[0] < 2) {
+        return false;
+    }
+
+    const std::size_t size = getPaddedSize((header[0] + 3) * sizeof(T));
+
+    if (static_cast<std::size_t>(end - pos) < size) {
+        return false;
+    }
+
+    // the mapping is read-only, the tables must not be modified after Color::init()
+    lut.wrap(reinterpret_cast<T*>(const_cast<char*>(pos)), header[0], header[1]);
+    pos += size;
+    return true;
+}
+
+bool mapColorTables(const std::vector<LUTf*>& tables, LUTuc& thumbTable)
+{
+    const Glib::ustring fileName = getColorTablesFileName();
+
+    if (fileName.empty()) {
+        return false;
+    }
+
+    GMappedFile* const file = g_mapped_file_new(fileName.c_str(), FALSE, nullptr);
+
+    if (!file) {
+        return false;
+    }
+
+    const char* pos = g_mapped_file_get_contents(file);
+    const char* const end = pos + g_mapped_file_get_length(file);
+    std::int32_t header[2];
+    bool ok = static_cast<std::size_t>(end - pos) >= sizeof(colorTablesMagic) + sizeof(header) && !memcmp(pos, colorTablesMagic, sizeof(colorTablesMagic));
+
+    if (ok) {
+        memcpy(header, pos + sizeof(colorTablesMagic), sizeof(header));
+        pos += sizeof(colorTablesMagic) + sizeof(header);
+        ok = header[0] == settings->denoiselabgamma && header[1] == static_cast<std::int32_t>(tables.size());
+    }
+
+    if (ok) {
+        const std::string& buildId = getBuildId();
+        std::int32_t idHeader[4];
+        ok = static_cast<std::size_t>(end - pos) >= sizeof(idHeader) + getPaddedSize(buildId.size());
+
+        if (ok) {
+            memcpy(idHeader, pos, sizeof(idHeader));
+            pos += sizeof(idHeader);
+            ok = idHeader[0] == static_cast<std::int32_t>(buildId.size()) && !memcmp(pos, buildId.data(), buildId.size());
+            pos += getPaddedSize(buildId.size());
+        }
+    }
+
+    // on failure the tables which are already mapped get reallocated by Color::initTables()
+    for (size_t i = 0; ok && i < tables.size(); ++i) {
+        ok = mapTable(pos, end, *tables[i]);
+    }
+
+    ok = ok && mapTable(pos, end, thumbTable) && pos == end;
+
+    if (!ok) {
+        g_mapped_file_unref(file);
+
+        if (settings->verbose) {
+            std::cerr << "Invalid color tables file " << fileName << std::endl;
+        }
+
+        return false;
+    }
+
+    colorTablesFile = file;
+    return true;
+}
+
+void storeColorTables(const std::vector<LUTf*>& tables, const LUTuc& thumbTable)
+{
+    const Glib::ustring fileName = getColorTablesFileName();
+
+    if (fileName.empty() || g_mkdir_with_parents(options.cacheBaseDir.c_str(), 0777) != 0) {
+        return;
+    }
+
+    // write to a temporary file first, other instances may be mapping the file
+    const Glib::ustring tmpName = fileName + ".tmp" + std::to_string(g_random_int());
+    FILE* const f = g_fopen(tmpName.c_str(), "wb");
+
+    if (!f) {
+        return;
+    }
+
+    const std::int32_t header[2] = {settings->denoiselabgamma, static_cast<std::int32_t>(tables.size())};
+    const std::string& buildId = getBuildId();
+    const std::int32_t idHeader[4] = {static_cast<std::int32_t>(buildId.size()), 0, 0, 0};
+    const std::string paddedId = buildId + std::string(getPaddedSize(buildId.size()) - buildId.size(), '\0');
+    bool ok = fwrite(colorTablesMagic, sizeof(colorTablesMagic), 1, f) == 1 && fwrite(header, sizeof(header), 1, f) == 1
+              && fwrite(idHeader, sizeof(idHeader), 1, f) == 1 && fwrite(paddedId.data(), paddedId.size(), 1, f) == 1;
+
+    for (size_t i = 0; ok && i < tables.size(); ++i) {
+        ok = writeTable(f, *tables[i]);
+    }
+
+    ok = ok && writeTable(f, thumbTable);
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || g_rename(tmpName.c_str(), fileName.c_str()) != 0) {
+        g_remove(tmpName.c_str());
+
+        if (settings->verbose) {
+            std::cerr << "Failed to write color tables file " << fileName << std::endl;
+        }
+    }
+}
+
+}
+
 void Color::init ()
+{
+    // These tables take long to compute. They are mapped read-only from a file in the cache folder when possible,
+    // which also shares their memory between all running instances.
+    const std::vector<LUTf*> cachedTables = {
+        &cachef, &cachefy, &gammatab,
+        &igammatab_srgb, &igammatab_bt709, &igammatab_srgb1, &gammatab_srgb, &gammatab_bt709, &gammatab_srgb1, &gammatab_srgb327,
+        &denoiseGammaTab, &denoiseIGammaTab,
+        &igammatab_24_17, &gammatab_24_17a, &gammatab_13_2, &igammatab_13_2, &gammatab_115_2, &igammatab_115_2, &gammatab_145_3, &igammatab_145_3
+    };
+
+    if (!mapColorTables(cachedTables, gammatabThumb)) {
+        initTables();
+        storeColorTables(cachedTables, gammatabThumb);
+    }
+
+    gamma2curve.share(gammatab_srgb, LUT_CLIP_BELOW | LUT_CLIP_ABOVE); // shares the buffer with gammatab_srgb but has different clip flags
+    initMunsell();
+    linearGammaTRC = cmsBuildGamma(nullptr, 1.0);
+}
+
+void Color::initTables ()
 {
 
     /*******************************************/
@@ -181,7 +384,6 @@ void Color::init ()
                 gammatab_srgb[i] = gammatab_srgb1[i] = gamma2(i / 65535.0);
             }
             gammatab_srgb *= 65535.f;
-            gamma2curve.share(gammatab_srgb, LUT_CLIP_BELOW | LUT_CLIP_ABOVE); // shares the buffer with gammatab_srgb but has different clip flags
         }
 #ifdef _OPENMP
         #pragma omp section
@@ -362,16 +564,6 @@ void Color::init ()
         for (int i = 0; i < maxindex; i++) {
             igammatab_24_17[i] = 65535.0 * igamma24_17 (i / 65535.0);
         }
-
-#ifdef _OPENMP
-        #pragma omp section
-#endif
-        initMunsell();
-
-#ifdef _OPENMP
-        #pragma omp section
-#endif
-        linearGammaTRC = cmsBuildGamma(nullptr, 1.0);
     }
 }
 
@@ -380,6 +572,11 @@ void Color::cleanup ()
     if (linearGammaTRC) {
         cmsFreeToneCurve(linearGammaTRC);
     }
+
+    if (colorTablesFile) {
+        g_mapped_file_unref(colorTablesFile);
+        colorTablesFile = nullptr;
+    }
 }
 
 void Color::rgb2lab01 (const Glib::ustring &profile, const Glib::ustring &profileW, float r, float g, float b, float &LAB_l, float &LAB_a, float &LAB_b, bool workingSpace)
@@ -1663,6 +1860,17 @@ inline float Color::computeXYZ2Lab(float f)
 
 void Color::RGB2Lab(float *R, float *G, float *B, float *L, float *a, float *b, const float wp[3][3], int width)
 {
+    if (const simd::Kernels* kernels = simd::getKernels()) {
+        kernels->rgb2lab(R, G, B, L, a, b, wp, width, &cachef[0], &cachefy[0], [](float x, float y, float z, float &Lout, float &aout, float &bout) {
+            const float fx = computeXYZ2Lab(x);
+            const float fy = computeXYZ2Lab(y);
+            const float fz = computeXYZ2Lab(z);
+            Lout = computeXYZ2LabY(y);
+            aout = 500.f * (fx - fy);
+            bout = 200.f * (fy - fz);
+        });
+        return;
+    }
 
 #ifdef __SSE2__
     const vfloat minvalfv = ZEROV;
@@ -1766,6 +1974,10 @@ void Color::RGB2L(const float *R, const float *G, const float *B, float *L, cons
 
 void Color::Lab2RGBLimit(float *L, float *a, float *b, float *R, float *G, float *B, const float wp[3][3], float limit, float afactor, float bfactor, int width)
 {
+    if (const simd::Kernels* kernels = simd::getKernels()) {
+        kernels->lab2rgbLimit(L, a, b, R, G, B, wp, limit, afactor, bfactor, width);
+        return;
+    }
 
     int i = 0;
 
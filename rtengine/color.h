@@ -77,6 +77,7 @@ private:
 
     // Separated from init() to keep the code clear
     static void initMunsell ();
+    static void initTables ();
     static double hue2rgb(double p, double q, double t);
     static float hue2rgbfloat(float p, float q, float t);
 #ifdef __SSE2__
@@ -25,6 +25,7 @@
 /*RT*/#include <omp.h>
 /*RT*/#endif
 
+#include <array>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -258,6 +259,20 @@ char *my_strcasestr (char *haystack, const char *needle)
 #define strcasestr my_strcasestr
 #endif
 
+#ifdef LOCALTIME
+/*RT*/ // gmtime() returns a buffer shared by all threads, several raw files may be loaded at once
+static time_t gmtime_to_local (time_t timestamp)
+{
+  struct tm t;
+#ifdef WIN32
+  if (gmtime_s (&t, &timestamp)) return timestamp;
+#else
+  if (!gmtime_r (&timestamp, &t)) return timestamp;
+#endif
+  return mktime (&t);
+}
+#endif
+
 void CLASS merror (void *ptr, const char *where)
 {
   if (ptr) return;
@@ -267,6 +282,15 @@ void CLASS merror (void *ptr, const char *where)
 
 void CLASS derror()
 {
+#ifdef _OPENMP
+  if (omp_in_parallel()) {
+    // decoders running in parallel only count their errors, the message
+    // below reads the shared ifp. They report after their parallel region.
+    #pragma omp atomic
+    data_error++;
+    return;
+  }
+#endif
   if (!data_error) {
     fprintf (stderr, "%s: ", ifname);
     if (feof(ifp))
@@ -604,36 +628,6 @@ inline unsigned CLASS getbithuff_t::operator() (int nbits, ushort *huff)
 #define getbits(n) getbithuff(n,0)
 #define gethuff(h) getbithuff(*h,h+1)
 
-inline unsigned CLASS nikbithuff_t::operator() (int nbits, ushort *huff)
-{
-    unsigned c;
-
-    if (UNLIKELY(nbits == 0)) {
-        return 0;
-    }
-    if (vbits < nbits && LIKELY((c = fgetc(ifp)) != EOF)) {
-        bitbuf = (bitbuf << 8) | c;
-        vbits += 8;
-        if (vbits < nbits && LIKELY((c = fgetc(ifp)) != EOF)) {
-            bitbuf = (bitbuf << 8) | c;
-            vbits += 8;
-        }
-    }
-    c = bitbuf << (32-vbits) >> (32-nbits);
-    if (huff) {
-        vbits -= huff[c] >> 8;
-        c = (uchar) huff[c];
-        derror(vbits < 0);
-    } else {
-        vbits -= nbits;
-    }
-    return c;
-}
-
-#define nikinit(n) nikbithuff()
-#define nikbits(n) nikbithuff(n,0)
-#define nikhuff(h) nikbithuff(*h,h+1)
-
 /*
    Construct a decode tree according the specification in *source.
    The first 16 bytes specify how many codes should be 1-bit, 2-bit
@@ -770,7 +764,7 @@ int CLASS canon_has_lowbits()
 void CLASS canon_load_raw()
 {
   ushort *pixel, *prow, *huff[2];
-  int nblocks, lowbits, i, c, row, r, save, val;
+  int nblocks, lowbits, i, c, row, r, val;
   int block, diffbuf[64], leaf, len, diff, carry=0, pnum=0, base[2];
 
   crw_init_tables (tiff_compress, huff);
@@ -778,20 +772,20 @@ void CLASS canon_load_raw()
   if (!lowbits) maximum = 0x3ff;
   fseek (ifp, 540 + lowbits*raw_height*raw_width/4, SEEK_SET);
   zero_after_ff = 1;
-  getbits(-1);
+  fastbithuff_t pump (this, ifp, zero_after_ff);
   for (row=0; row < raw_height; row+=8) {
     pixel = raw_image + row*raw_width;
     nblocks = MIN (8, raw_height-row) * raw_width >> 6;
     for (block=0; block < nblocks; block++) {
       memset (diffbuf, 0, sizeof diffbuf);
       for (i=0; i < 64; i++ ) {
-	leaf = gethuff(huff[i > 0]);
+	leaf = pump.read_huff(huff[i > 0]);
 	if (leaf == 0 && i) break;
 	if (leaf == 0xff) continue;
 	i  += leaf >> 4;
 	len = leaf & 15;
 	if (len == 0) continue;
-	diff = getbits(len);
+	diff = pump.read_bits(len);
 	if ((diff & (1 << (len-1))) == 0)
 	  diff -= (1 << len) - 1;
 	if (i < 64) diffbuf[i] = diff;
@@ -806,7 +800,7 @@ void CLASS canon_load_raw()
       }
     }
     if (lowbits) {
-      save = ftell(ifp);
+      // the pump reads the data directly, so the file position can be moved in between
       fseek (ifp, 26 + row*raw_width/4, SEEK_SET);
       for (prow=pixel, i=0; i < raw_width*2; i++) {
 	c = fgetc(ifp);
@@ -816,7 +810,6 @@ void CLASS canon_load_raw()
 	  *prow = val;
 	}
       }
-      fseek (ifp, save, SEEK_SET);
     }
   }
   FORC(2) free (huff[c]);
@@ -832,6 +825,11 @@ struct jhead {
 };
 
 int CLASS ljpeg_start (struct jhead *jh, int info_only)
+{
+  return ljpeg_start (jh, info_only, ifp, zero_after_ff);
+}
+
+int CLASS ljpeg_start (struct jhead *jh, int info_only, IMFILE *ifp, unsigned &zero_after_ff)
 {
   ushort c, tag, len;
   uchar data[0x10000];
@@ -883,6 +881,13 @@ int CLASS ljpeg_start (struct jhead *jh, int info_only)
     FORC(4)        jh->huff[2+c] = jh->huff[1];
     FORC(jh->sraw) jh->huff[1+c] = jh->huff[0];
   }
+  FORC(20) if (jh->free[c]) {
+    jh->lookahead_free[c] = (struct ljpeg_lookahead *) malloc (sizeof (struct ljpeg_lookahead));
+    merror (jh->lookahead_free[c], "ljpeg_start()");
+    ljpeg_make_lookahead (jh->free[c], jh->lookahead_free[c]);
+  }
+  for (int i=0; i < 20; i++)
+    FORC(20) if (jh->huff[i] == jh->free[c]) jh->lookahead[i] = jh->lookahead_free[c];
   jh->row = (ushort *) calloc (2 * jh->wide*jh->clrs, 4);
   merror (jh->row, "ljpeg_start()");
   return zero_after_ff = 1;
@@ -892,10 +897,47 @@ void CLASS ljpeg_end (struct jhead *jh)
 {
   int c;
   FORC4 if (jh->free[c]) free (jh->free[c]);
+  FORC(20) free (jh->lookahead_free[c]);
   free (jh->row);
 }
 
-inline int CLASS ljpeg_diff (ushort *huff)
+/*
+   For each value of the next ljpeg_lookahead::nbits bits, store the
+   difference and the total length of the Huffman code plus its
+   difference bits, when both fit.
+ */
+void CLASS ljpeg_make_lookahead (const ushort *huff, struct ljpeg_lookahead *lookahead)
+{
+  const int nbits = ljpeg_lookahead::nbits;
+  const int max = huff[0];
+
+  for (int i=0; i < 1 << nbits; i++) {
+    lookahead->diff[i] = 0;
+    lookahead->length[i] = 0;
+    if (!max) continue;
+    const int code = max <= nbits ? i >> (nbits - max) : i << (max - nbits);
+    const int len = huff[code+1] >> 8;
+    const int dlen = (uchar) huff[code+1];
+    if (!len || len + dlen > nbits) continue;
+    int diff = dlen ? (i >> (nbits - len - dlen)) & ((1 << dlen) - 1) : 0;
+    if (dlen && (diff & (1 << (dlen-1))) == 0)
+      diff -= (1 << dlen) - 1;
+    lookahead->diff[i] = diff;
+    lookahead->length[i] = len + dlen;
+  }
+}
+
+void CLASS fastbithuff_t::restart()
+{
+  imfile_bits_sync (&bits, ifp);
+  unsigned mark = 0;
+  int c;
+  do mark = (mark << 8) + (c = fgetc(ifp));
+  while (c != EOF && mark >> 4 != 0xffd);
+  imfile_bits_init (&bits, ifp, bits.zero_after_ff);
+}
+
+inline int CLASS ljpeg_diff (ushort *huff, getbithuff_t &getbithuff)
 {
   int len, diff;
 
@@ -908,24 +950,25 @@ inline int CLASS ljpeg_diff (ushort *huff)
   return diff;
 }
 
-ushort * CLASS ljpeg_row (int jrow, struct jhead *jh)
+inline int CLASS ljpeg_diff (ushort *huff)
+{
+  return ljpeg_diff (huff, getbithuff);
+}
+
+ushort * CLASS ljpeg_row (int jrow, struct jhead *jh, fastbithuff_t &pump)
 {
   int col, c, diff, pred, spred=0;
-  ushort mark=0, *row[3];
+  ushort *row[3];
 
   if (jrow * jh->wide % jh->restart == 0) {
     FORC(6) jh->vpred[c] = 1 << (jh->bits-1);
-    if (jrow) {
-      fseek (ifp, -2, SEEK_CUR);
-      do mark = (mark << 8) + (c = fgetc(ifp));
-      while (c != EOF && mark >> 4 != 0xffd);
-    }
-    getbits(-1);
+    if (jrow)
+      pump.restart();
   }
   FORC3 row[c] = jh->row + jh->wide*jh->clrs*((jrow+c) & 1);
   for (col=0; col < jh->wide; col++)
     FORC(jh->clrs) {
-      diff = ljpeg_diff (jh->huff[c]);
+      diff = pump.ljpeg_diff (jh->huff[c], jh->lookahead[c]);
       if (jh->sraw && c <= jh->sraw && (col | c))
 		    pred = spred;
       else if (col) pred = row[0][-jh->clrs];
@@ -954,7 +997,8 @@ void CLASS lossless_jpeg_load_raw()
   if (!ljpeg_start (&jh, 0)) return;
   int jwide = jh.wide * jh.clrs;
   ushort *rp[2];
-  rp[0] = ljpeg_row (0, &jh);
+  fastbithuff_t pump (this, ifp, true);
+  rp[0] = ljpeg_row (0, &jh, pump);
 
   for (int jrow=0; jrow < jh.high; jrow++) {
 #ifdef _OPENMP
@@ -966,7 +1010,7 @@ void CLASS lossless_jpeg_load_raw()
 #endif
     {
         if(jrow < jh.high - 1)
-            rp[(jrow + 1)&1] = ljpeg_row (jrow + 1, &jh);
+            rp[(jrow + 1)&1] = ljpeg_row (jrow + 1, &jh, pump);
     }
 #ifdef _OPENMP
      #pragma omp section
@@ -1008,6 +1052,7 @@ void CLASS canon_sraw_load_raw()
 
   if (!ljpeg_start (&jh, 0) || jh.clrs < 4) return;
   jwide = (jh.wide >>= 1) * jh.clrs;
+  fastbithuff_t pump (this, ifp, true);
 
   for (ecol=slice=0; slice <= cr2_slice[0]; slice++) {
     scol = ecol;
@@ -1017,7 +1062,7 @@ void CLASS canon_sraw_load_raw()
       ip = (short (*)[4]) image + row*width;
       for (col=scol; col < ecol; col+=2, jcol+=jh.clrs) {
 	if ((jcol %= jwide) == 0)
-	  rp = (short *) ljpeg_row (jrow++, &jh);
+	  rp = (short *) ljpeg_row (jrow++, &jh, pump);
 	if (col >= width) continue;
 	FORC (jh.clrs-2)
 	  ip[col + (c >> 1)*width + (c & 1)][0] = rp[jcol+c];
@@ -1090,20 +1135,29 @@ void CLASS adobe_copy_pixel (unsigned row, unsigned col, ushort **rp)
 }
 
 void CLASS ljpeg_idct (struct jhead *jh)
+{
+  ljpeg_idct (jh, getbithuff);
+}
+
+void CLASS ljpeg_idct (struct jhead *jh, getbithuff_t &getbithuff)
 {
   int c, i, j, len, skip, coef;
   float work[3][8][8];
-  static float cs[106] = { 0 };
+  // thread safe initialization, tiles can be decoded concurrently
+  static const std::array<float, 106> cs = []() {
+    std::array<float, 106> table;
+    for (int c = 0; c < 106; c++)
+      table[c] = cos((c & 31)*rtengine::RT_PI/16)/2;
+    return table;
+  }();
   static const uchar zigzag[80] =
   {  0, 1, 8,16, 9, 2, 3,10,17,24,32,25,18,11, 4, 5,12,19,26,33,
     40,48,41,34,27,20,13, 6, 7,14,21,28,35,42,49,56,57,50,43,36,
     29,22,15,23,30,37,44,51,58,59,52,45,38,31,39,46,53,60,61,54,
     47,55,62,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63,63 };
 
-  if (!cs[0])
-    FORC(106) cs[c] = cos((c & 31)*rtengine::RT_PI/16)/2;
   memset (work, 0, sizeof work);
-  work[0][0][0] = jh->vpred[0] += ljpeg_diff (jh->huff[0]) * jh->quant[0];
+  work[0][0][0] = jh->vpred[0] += ljpeg_diff (jh->huff[0], getbithuff) * jh->quant[0];
   for (i=1; i < 64; i++ ) {
     len = gethuff (jh->huff[16]);
     i += skip = len >> 4;
@@ -1125,49 +1179,102 @@ void CLASS ljpeg_idct (struct jhead *jh)
   FORC(64) jh->idct[c] = CLIP(((float *)work[2])[c]+0.5);
 }
 
-void CLASS lossless_dng_load_raw()
+bool CLASS lossless_dng_decode_tile (unsigned trow, unsigned tcol, IMFILE *ifp, getbithuff_t &getbithuff, unsigned &zero_after_ff)
 {
-  unsigned save, trow=0, tcol=0, jwide, jrow, jcol, row, col, i, j;
+  unsigned jwide, jrow, jcol, row, col, i, j;
   struct jhead jh;
   ushort *rp;
 
+  if (!ljpeg_start (&jh, 0, ifp, zero_after_ff)) return false;
+  jwide = jh.wide;
+  if (filters || (colors == 1 && jh.clrs > 1)) jwide *= jh.clrs;
+  jwide /= MIN (is_raw, tiff_samples);
+  switch (jh.algo) {
+    case 0xc1:
+      jh.vpred[0] = 16384;
+      getbits(-1);
+      for (jrow=0; jrow+7 < jh.high; jrow += 8) {
+	for (jcol=0; jcol+7 < jh.wide; jcol += 8) {
+	  ljpeg_idct (&jh, getbithuff);
+	  rp = jh.idct;
+	  row = trow + jcol/tile_width + jrow*2;
+	  col = tcol + jcol%tile_width;
+	  for (i=0; i < 16; i+=2)
+	    for (j=0; j < 8; j++)
+	      adobe_copy_pixel (row+i, col+j, &rp);
+	}
+      }
+      break;
+    case 0xc3: {
+      fastbithuff_t pump (this, ifp, true);
+      for (row=col=jrow=0; jrow < jh.high; jrow++) {
+	rp = ljpeg_row (jrow, &jh, pump);
+	for (jcol=0; jcol < jwide; jcol++) {
+	  adobe_copy_pixel (trow+row, tcol+col, &rp);
+	  if (++col >= tile_width || col >= raw_width)
+	    row += 1 + (col = 0);
+	}
+      }
+    }
+  }
+  ljpeg_end (&jh);
+  return true;
+}
+
+void CLASS lossless_dng_load_raw()
+{
+  unsigned save, trow=0, tcol=0;
+
+#if defined( _OPENMP ) && defined( MYFILE_MMAP )
+  if (tile_length < INT_MAX && tile_width < INT_MAX) {
+    // The tiles are independent lossless JPEG streams, decode them in parallel.
+    // Each thread reads through its own copy of ifp with its own bit pump.
+    const int tilesAcross = (raw_width + tile_width - 1) / tile_width;
+    const int tilesDown = (raw_height + tile_length - 1) / tile_length;
+    std::vector<unsigned> tileOffsets (tilesAcross * tilesDown);
+    for (auto &offset : tileOffsets)
+      offset = get4();
+    const unsigned errorsBefore = data_error;
+
+#pragma omp parallel
+{
+    IMFILE tileFile = *ifp;
+    IMFILE *tileIfp = &tileFile;
+    unsigned tileZeroAfterFF = 0;
+    getbithuff_t tileGetbithuff (this, tileIfp, tileZeroAfterFF);
+
+    // only master thread will update the progress bar
+    tileFile.plistener = nullptr;
+    #pragma omp master
+    {
+    tileFile.plistener = ifp->plistener;
+    }
+
+    #pragma omp for schedule(dynamic)
+    for (int tile = 0; tile < tilesAcross * tilesDown; tile++) {
+      fseek (tileIfp, tileOffsets[tile], SEEK_SET);
+      lossless_dng_decode_tile ((tile / tilesAcross) * tile_length, (tile % tilesAcross) * tile_width, tileIfp, tileGetbithuff, tileZeroAfterFF);
+    }
+}
+    if (data_error != errorsBefore) {
+      // the tiles only counted their errors, report them once
+      const unsigned errors = data_error;
+      data_error = errorsBefore;
+      derror();
+      data_error = errors;
+    }
+    return;
+  }
+#endif
+
   while (trow < raw_height) {
     save = ftell(ifp);
     if (tile_length < INT_MAX)
       fseek (ifp, get4(), SEEK_SET);
-    if (!ljpeg_start (&jh, 0)) break;
-    jwide = jh.wide;
-    if (filters || (colors == 1 && jh.clrs > 1)) jwide *= jh.clrs;
-    jwide /= MIN (is_raw, tiff_samples);
-    switch (jh.algo) {
-      case 0xc1:
-	jh.vpred[0] = 16384;
-	getbits(-1);
-	for (jrow=0; jrow+7 < jh.high; jrow += 8) {
-	  for (jcol=0; jcol+7 < jh.wide; jcol += 8) {
-	    ljpeg_idct (&jh);
-	    rp = jh.idct;
-	    row = trow + jcol/tile_width + jrow*2;
-	    col = tcol + jcol%tile_width;
-	    for (i=0; i < 16; i+=2)
-	      for (j=0; j < 8; j++)
-		adobe_copy_pixel (row+i, col+j, &rp);
-	  }
-	}
-	break;
-      case 0xc3:
-	for (row=col=jrow=0; jrow < jh.high; jrow++) {
-	  rp = ljpeg_row (jrow, &jh);
-	  for (jcol=0; jcol < jwide; jcol++) {
-	    adobe_copy_pixel (trow+row, tcol+col, &rp);
-	    if (++col >= tile_width || col >= raw_width)
-	      row += 1 + (col = 0);
-	  }
-	}    }
+    if (!lossless_dng_decode_tile (trow, tcol, ifp, getbithuff, zero_after_ff)) break;
     fseek (ifp, save+4, SEEK_SET);
     if ((tcol += tile_width) >= raw_width)
       trow += tile_length + (tcol = 0);
-    ljpeg_end (&jh);
   }
 }
 
@@ -1230,11 +1337,13 @@ void CLASS pentax_load_raw()
     for (i=bit[0][c]; i <= ((bit[0][c]+(4096 >> bit[1][c])-1) & 4095); )
       huff[++i] = bit[1][c] << 8 | c;
   huff[0] = 12;
+  struct ljpeg_lookahead lookahead;
+  ljpeg_make_lookahead (huff, &lookahead);
   fseek (ifp, data_offset, SEEK_SET);
-  getbits(-1);
+  fastbithuff_t pump (this, ifp, zero_after_ff);
   for (row=0; row < raw_height; row++)
     for (col=0; col < raw_width; col++) {
-      diff = ljpeg_diff (huff);
+      diff = pump.ljpeg_diff (huff, &lookahead);
       if (col < 2) hpred[col] = vpred[row & 1][col] += diff;
       else	   hpred[col & 1] += diff;
       RAW(row,col) = hpred[col & 1];
@@ -1291,7 +1400,7 @@ void CLASS nikon_load_raw()
 
     huff = make_decoder (nikon_tree[tree]);
     fseek (ifp, data_offset, SEEK_SET);
-    nikinit();
+    fastbithuff_t pump (this, ifp, false);
     if (split) {
         for (int min = 0, row = 0; row < height; row++) {
             if (row == split) {
@@ -1300,10 +1409,10 @@ void CLASS nikon_load_raw()
                 max += (min = 16) << 1;
             }
             for (int col=0; col < raw_width; col++) {
-                int i = nikhuff(huff);
+                int i = pump.read_huff(huff);
                 int len = i & 15;
                 int shl = i >> 4;
-                int diff = ((nikbits(len-shl) << 1) + 1) << shl >> 1;
+                int diff = ((pump.read_bits(len-shl) << 1) + 1) << shl >> 1;
                 if ((diff & (1 << (len-1))) == 0)
                     diff -= (1 << len) - !shl;
                 if (col < 2) hpred[col] = vpred[row & 1][col] += diff;
@@ -1313,29 +1422,23 @@ void CLASS nikon_load_raw()
             }
         }
     } else {
+        // the lossless and unsplit lossy trees have no code of length 16, so ljpeg_diff() decodes them
+        struct ljpeg_lookahead lookahead;
+        ljpeg_make_lookahead (huff, &lookahead);
         for (int row=0; row < height; row++) {
             for (int col=0; col < 2; col++) {
-                int len = nikhuff(huff);
-                int diff = nikbits(len);
-                if ((diff & (1 << (len-1))) == 0)
-                    diff -= (1 << len) - 1;
-                hpred[col] = vpred[row & 1][col] += diff;
+                hpred[col] = vpred[row & 1][col] += pump.ljpeg_diff(huff, &lookahead);
                 derror(hpred[col] >= max);
                 RAW(row,col) = curve[hpred[col]];
             }
             for (int col=2; col < raw_width; col++) {
-                int len = nikhuff(huff);
-                int diff = nikbits(len);
-                if ((diff & (1 << (len-1))) == 0)
-                    diff -= (1 << len) - 1;
-                hpred[col & 1] += diff;
+                hpred[col & 1] += pump.ljpeg_diff(huff, &lookahead);
                 derror(hpred[col & 1] >= max);
                 RAW(row,col) = curve[hpred[col & 1]];
             }
         }
     }
     free (huff);
-    data_error += nikbithuff.errorCount();
     if(data_error) {
         std::cerr << ifname << " decoded with " << data_error << " errors. File possibly corrupted." << std::endl;
     }
@@ -2628,26 +2731,27 @@ void CLASS canon_rmf_load_raw()
 
 void CLASS olympus_load_raw()
 {
-  ushort huff[4096];
+  ushort huff[4097];
   int row, col, nbits, sign, low, high, i, c, w, n, nw;
   int acarry[2][3], *carry, pred, diff;
 
-  huff[n=0] = 0xc0c;
+  huff[0] = 12;
+  huff[n=1] = 0xc0c;
   for (i=12; i--; )
     FORC(2048 >> i) huff[++n] = (i+1) << 8 | i;
   fseek (ifp, 7, SEEK_CUR);
-  getbits(-1);
+  fastbithuff_t pump (this, ifp, zero_after_ff);
   for (row=0; row < height; row++) {
     memset (acarry, 0, sizeof acarry);
     for (col=0; col < raw_width; col++) {
       carry = acarry[col & 1];
       i = 2 * (carry[2] < 3);
       for (nbits=2+i; (ushort) carry[0] >> (nbits+i); nbits++);
-      low = (sign = getbits(3)) & 3;
+      low = (sign = pump.read_bits(3)) & 3;
       sign = sign << 29 >> 31;
-      if ((high = getbithuff(12,huff)) == 12)
-	high = getbits(16-nbits) >> 1;
-      carry[0] = (high << nbits) | getbits(nbits);
+      if ((high = pump.read_huff(huff)) == 12)
+	high = pump.read_bits(16-nbits) >> 1;
+      carry[0] = (high << nbits) | pump.read_bits(nbits);
       diff = (carry[0] ^ sign) + carry[1];
       carry[1] = (diff*3 + carry[1]) >> 5;
       carry[2] = carry[0] > 16 ? 0 : carry[2]+1;
@@ -3091,22 +3195,25 @@ void CLASS kodak_262_load_raw()
   { { 0,1,5,1,1,2,0,0,0,0,0,0,0,0,0,0, 0,1,2,3,4,5,6,7,8,9 },
     { 0,3,1,1,1,1,1,2,0,0,0,0,0,0,0,0, 0,1,2,3,4,5,6,7,8,9 } };
   ushort *huff[2];
+  struct ljpeg_lookahead lookahead[2];
   uchar *pixel;
   int *strip, ns, c, row, col, chess, pi=0, pi1, pi2, pred, val;
 
-  FORC(2) huff[c] = make_decoder (kodak_tree[c]);
+  FORC(2) {
+    huff[c] = make_decoder (kodak_tree[c]);
+    ljpeg_make_lookahead (huff[c], &lookahead[c]);
+  }
   ns = (raw_height+63) >> 5;
   pixel = (uchar *) malloc (raw_width*32 + ns*4);
   merror (pixel, "kodak_262_load_raw()");
   strip = (int *) (pixel + raw_width*32);
   order = 0x4d4d;
   FORC(ns) strip[c] = get4();
-  for (row=0; row < raw_height; row++) {
-    if ((row & 31) == 0) {
-      fseek (ifp, strip[row >> 5], SEEK_SET);
-      getbits(-1);
-      pi = 0;
-    }
+  for (int srow=0; srow < raw_height; srow+=32) {
+    fseek (ifp, strip[srow >> 5], SEEK_SET);
+    fastbithuff_t pump (this, ifp, zero_after_ff);
+    pi = 0;
+    for (row=srow; row < MIN(srow+32, raw_height); row++)
     for (col=0; col < raw_width; col++) {
       chess = (row + col) & 1;
       pi1 = chess ? pi-2           : pi-raw_width-1;
@@ -3116,7 +3223,7 @@ void CLASS kodak_262_load_raw()
       if (pi2 < 0) pi2 = pi1;
       if (pi1 < 0 && col > 1) pi1 = pi2 = pi-2;
       pred = (pi1 < 0) ? 0 : (pixel[pi1] + pixel[pi2]) >> 1;
-      pixel[pi] = val = pred + ljpeg_diff (huff[chess]);
+      pixel[pi] = val = pred + pump.ljpeg_diff (huff[chess], &lookahead[chess]);
       if (val >> 8) derror();
       val = curve[pixel[pi++]];
       RAW(row,col) = val;
@@ -3299,11 +3406,13 @@ void CLASS sony_arw_load_raw()
   huff[0] = 15;
   for (n=i=0; i < 18; i++)
     FORC(32768 >> (tab[i] >> 8)) huff[++n] = tab[i];
-  getbits(-1);
+  struct ljpeg_lookahead lookahead;
+  ljpeg_make_lookahead (huff, &lookahead);
+  fastbithuff_t pump (this, ifp, zero_after_ff);
   for (col = raw_width; col--; )
     for (row=0; row < raw_height+1; row+=2) {
       if (row == raw_height) row = 1;
-      if ((sum += ljpeg_diff(huff)) >> 12) derror();
+      if ((sum += pump.ljpeg_diff(huff, &lookahead)) >> 12) derror();
       if (row < height) RAW(row,col) = sum;
     }
 }
@@ -3411,10 +3520,12 @@ void CLASS samsung2_load_raw()
   huff[0] = 10;
   for (n=i=0; i < 14; i++)
     FORC(1024 >> (tab[i] >> 8)) huff[++n] = tab[i];
-  getbits(-1);
+  struct ljpeg_lookahead lookahead;
+  ljpeg_make_lookahead (huff, &lookahead);
+  fastbithuff_t pump (this, ifp, zero_after_ff);
   for (row=0; row < raw_height; row++)
     for (col=0; col < raw_width; col++) {
-      diff = ljpeg_diff (huff);
+      diff = pump.ljpeg_diff (huff, &lookahead);
       if (col < 2) hpred[col] = vpred[row & 1][col] += diff;
       else	   hpred[col & 1] += diff;
       RAW(row,col) = hpred[col & 1];
@@ -7372,7 +7483,7 @@ void CLASS parse_ciff (int offset, int length, int depth)
     if (type == 0x180e) timestamp  = get4();
 #ifdef LOCALTIME
     if ((type | 0x4000) == 0x580e)
-      timestamp = mktime (gmtime (&timestamp));
+      timestamp = gmtime_to_local (timestamp);
 #endif
     fseek (ifp, save, SEEK_SET);
   }
@@ -7838,7 +7949,7 @@ void CLASS parse_foveon()
 	    focal_len = atof(value);
 	}
 #ifdef LOCALTIME
-	timestamp = mktime (gmtime (&timestamp));
+	timestamp = gmtime_to_local (timestamp);
 #endif
     }
     fseek (ifp, save, SEEK_SET);
@@ -10614,9 +10725,53 @@ notraw:
 // #include <zlib.h>
 // #include <stdint.h>
 
+#ifdef __SSE2__
+// Inclusive prefix sum of the bytes with a stride of factor, 16 bytes at a time.
+// Returns the number of bytes processed, the rest has to be done by the caller.
+template<int factor>
+static size_t decodeDeltaBytesSSE2(Bytef * src, size_t count) {
+  __m128i carry = _mm_setzero_si128();
+  size_t col = 0;
+  for (; col + 16 <= count; col += 16) {
+    __m128i v = _mm_loadu_si128((__m128i*)&src[col]);
+    v = _mm_add_epi8(v, _mm_slli_si128(v, factor));
+    v = _mm_add_epi8(v, _mm_slli_si128(v, 2 * factor));
+    if (4 * factor < 16) {
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 4 * factor));
+    }
+    if (8 * factor < 16) {
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 8 * factor));
+    }
+    v = _mm_add_epi8(v, carry);
+    _mm_storeu_si128((__m128i*)&src[col], v);
+    // broadcast the last factor bytes as carry for the next block
+    if (factor == 1) {
+      carry = _mm_unpackhi_epi8(v, v);
+      carry = _mm_shufflehi_epi16(carry, 0xff);
+      carry = _mm_unpackhi_epi64(carry, carry);
+    } else if (factor == 2) {
+      carry = _mm_shufflehi_epi16(v, 0xff);
+      carry = _mm_unpackhi_epi64(carry, carry);
+    } else {
+      carry = _mm_shuffle_epi32(v, 0xff);
+    }
+  }
+  return col;
+}
+#endif
+
 static void decodeFPDeltaRow(Bytef * src, Bytef * dst, size_t tileWidth, size_t realTileWidth, int bytesps, int factor) {
   // DecodeDeltaBytes
-  for (size_t col = factor; col < realTileWidth*bytesps; ++col) {
+  size_t col = factor;
+#ifdef __SSE2__
+  const size_t count = realTileWidth * bytesps;
+  switch (factor) {
+    case 1: col = std::max<size_t>(col, decodeDeltaBytesSSE2<1>(src, count)); break;
+    case 2: col = std::max<size_t>(col, decodeDeltaBytesSSE2<2>(src, count)); break;
+    case 4: col = std::max<size_t>(col, decodeDeltaBytesSSE2<4>(src, count)); break;
+  }
+#endif
+  for (; col < realTileWidth*bytesps; ++col) {
     src[col] += src[col - factor];
   }
   // Reorder bytes into the image
@@ -10630,7 +10785,34 @@ static void decodeFPDeltaRow(Bytef * src, Bytef * dst, size_t tileWidth, size_t
   } else {
     union X { uint32_t x; uint8_t c; };
     if (((union X){1}).c) {
-		for (size_t col = 0; col < tileWidth; ++col) {
+		size_t col = 0;
+#ifdef __SSE2__
+		// Little endian, interleave the byte planes 16 pixels at a time
+		if (bytesps == 4) {
+			for (; col + 16 <= tileWidth; col += 16) {
+				const __m128i p0 = _mm_loadu_si128((__m128i*)&src[col]);
+				const __m128i p1 = _mm_loadu_si128((__m128i*)&src[col + realTileWidth]);
+				const __m128i p2 = _mm_loadu_si128((__m128i*)&src[col + realTileWidth*2]);
+				const __m128i p3 = _mm_loadu_si128((__m128i*)&src[col + realTileWidth*3]);
+				const __m128i lo32 = _mm_unpacklo_epi8(p3, p2);
+				const __m128i hi32 = _mm_unpackhi_epi8(p3, p2);
+				const __m128i lo10 = _mm_unpacklo_epi8(p1, p0);
+				const __m128i hi10 = _mm_unpackhi_epi8(p1, p0);
+				_mm_storeu_si128((__m128i*)&dst[col*4], _mm_unpacklo_epi16(lo32, lo10));
+				_mm_storeu_si128((__m128i*)&dst[col*4 + 16], _mm_unpackhi_epi16(lo32, lo10));
+				_mm_storeu_si128((__m128i*)&dst[col*4 + 32], _mm_unpacklo_epi16(hi32, hi10));
+				_mm_storeu_si128((__m128i*)&dst[col*4 + 48], _mm_unpackhi_epi16(hi32, hi10));
+			}
+		} else if (bytesps == 2) {
+			for (; col + 16 <= tileWidth; col += 16) {
+				const __m128i p0 = _mm_loadu_si128((__m128i*)&src[col]);
+				const __m128i p1 = _mm_loadu_si128((__m128i*)&src[col + realTileWidth]);
+				_mm_storeu_si128((__m128i*)&dst[col*2], _mm_unpacklo_epi8(p1, p0));
+				_mm_storeu_si128((__m128i*)&dst[col*2 + 16], _mm_unpackhi_epi8(p1, p0));
+			}
+		}
+#endif
+		for (; col < tileWidth; ++col) {
 			for (size_t byte = 0; byte < bytesps; ++byte)
 				dst[col*bytesps + byte] = src[col + realTileWidth*(bytesps-byte-1)];  // Little endian
 		}
@@ -10850,7 +11032,9 @@ void CLASS deflate_dng_load_raw() {
 #pragma omp parallel
 #endif
 {
+#ifndef MYFILE_MMAP
     Bytef * cBuffer = new Bytef[maxCompressed];
+#endif
     Bytef * uBuffer = new Bytef[dstLen];
 
 #ifdef _OPENMP
@@ -10859,6 +11043,13 @@ void CLASS deflate_dng_load_raw() {
     for (size_t y = 0; y < raw_height; y += tile_length) {
         for (size_t x = 0; x < raw_width; x += tile_width) {
             size_t t = (y / tile_length) * tilesWide + (x / tile_width);
+#ifdef MYFILE_MMAP
+            // inflate straight from the mapped file, the threads don't need to wait for each other
+            int err = Z_DATA_ERROR;
+            if (tileOffsets[t] + tileBytes[t] <= static_cast<size_t>(ifp->size)) {
+                err = decompress(tileBytes[t], dstLen, fdata(tileOffsets[t], ifp), uBuffer);
+            }
+#else
 #ifdef _OPENMP
             #pragma omp critical
 #endif
@@ -10867,6 +11058,7 @@ void CLASS deflate_dng_load_raw() {
                 fread(cBuffer, 1, tileBytes[t], ifp);
             }
             int err = decompress(tileBytes[t], dstLen, cBuffer, uBuffer);
+#endif
             if (err != Z_OK) {
                 fprintf(stderr, "DNG Deflate: Failed uncompressing tile %d, with error %d\n", (int)t, err);
             } else if (ifd->sample_format == 3) {  // Floating point data
@@ -10887,7 +11079,9 @@ void CLASS deflate_dng_load_raw() {
         }
     }
 
+#ifndef MYFILE_MMAP
     delete [] cBuffer;
+#endif
     delete [] uBuffer;
 }
   }
@@ -61,7 +61,6 @@ public:
     ,RT_matrix_from_constant(ThreeValBool::X)
     ,RT_baseline_exposure(0)
 	,getbithuff(this,ifp,zero_after_ff)
-	,nikbithuff(ifp)
     {
         memset(&hbd, 0, sizeof(hbd));
         aber[0]=aber[1]=aber[2]=aber[3]=1;
@@ -223,9 +222,17 @@ protected:
         off_t levels, unknown1, flatfield;
     } hbd;
 
+    // Lookahead table of fastbithuff_t::ljpeg_diff(), decodes a Huffman code and its difference bits at once
+    struct ljpeg_lookahead {
+      static constexpr int nbits = 12;
+      short diff[1 << nbits];
+      uchar length[1 << nbits]; // 0 if the code and its difference don't fit in nbits
+    };
+
     struct jhead {
       int algo, bits, high, wide, clrs, sraw, psv, restart, vpred[6];
       ushort quant[64], idct[64], *huff[20], *free[20], *row;
+      struct ljpeg_lookahead *lookahead[20], *lookahead_free[20];
     };
 
     struct tiff_tag {
@@ -293,25 +300,68 @@ private:
 };
 getbithuff_t getbithuff;
 
-class nikbithuff_t
+// getbithuff() replacement for self-contained entropy coded streams. It reads straight from the
+// file data through a 64-bit buffer and holds all its state, so that several instances can decode
+// concurrently. The position of ifp is updated when the instance is destroyed.
+class fastbithuff_t
 {
 public:
-   explicit nikbithuff_t(IMFILE *&i):bitbuf(0),errors(0),vbits(0),ifp(i){}
-   void operator()() {bitbuf = vbits = 0;};
-   unsigned operator()(int nbits, ushort *huff);
-   unsigned errorCount() { return errors; }
+   fastbithuff_t(DCraw *p, IMFILE *i, bool zero_after_ff):parent(p),ifp(i){
+       imfile_bits_init(&bits, ifp, zero_after_ff);
+   }
+   ~fastbithuff_t(){
+       imfile_bits_sync(&bits, ifp);
+   }
+   fastbithuff_t(const fastbithuff_t&) = delete;
+   fastbithuff_t& operator=(const fastbithuff_t&) = delete;
+
+   unsigned read_bits(int nbits){
+       if (UNLIKELY(nbits == 0)) {
+           return 0;
+       }
+       const unsigned c = imfile_bits_peek(&bits, nbits);
+       skip(nbits);
+       return c;
+   }
+   unsigned read_huff(const ushort *huff){
+       if (UNLIKELY(huff[0] == 0)) {
+           return 0;
+       }
+       const ushort h = huff[imfile_bits_peek(&bits, huff[0]) + 1];
+       skip(h >> 8);
+       return (uchar) h;
+   }
+   int ljpeg_diff(const ushort *huff, const struct ljpeg_lookahead *lookahead){
+       if (LIKELY(lookahead)) {
+           const unsigned c = imfile_bits_peek(&bits, ljpeg_lookahead::nbits);
+           if (LIKELY(lookahead->length[c])) {
+               skip(lookahead->length[c]);
+               return lookahead->diff[c];
+           }
+       }
+       const int len = read_huff(huff);
+       if (len == 16 && (!parent->dng_version || parent->dng_version >= 0x1010000))
+           return -32768;
+       int diff = read_bits(len);
+       if (len && (diff & (1 << (len-1))) == 0)
+           diff -= (1 << len) - 1;
+       return diff;
+   }
+   // skips past the next JPEG restart marker
+   void restart();
+
 private:
-   inline bool derror(bool condition){
-       if (UNLIKELY(condition)) {
-           ++errors;
+   void skip(int nbits){
+       if (UNLIKELY(nbits > bits.vbits - bits.padding)) {
+           parent->derror();
        }
-	   return condition;
+       imfile_bits_skip(&bits, nbits);
    }
-   unsigned bitbuf, errors;
-   int vbits;
-   IMFILE *&ifp;
+   DCraw *parent;
+   IMFILE *ifp;
+   IMFILE_bits bits;
 };
-nikbithuff_t nikbithuff;
+
 
 ushort * make_decoder_ref (const uchar **source);
 ushort * make_decoder (const uchar *source);
@@ -321,13 +371,19 @@ void canon_load_raw();
 int ljpeg_start (struct jhead *jh, int info_only);
 void ljpeg_end (struct jhead *jh);
 int ljpeg_diff (ushort *huff);
-ushort * ljpeg_row (int jrow, struct jhead *jh);
 void lossless_jpeg_load_raw();
 void ljpeg_idct (struct jhead *jh);
+// reentrant versions, reading through the given file and bit pump instead of the members
+int ljpeg_start (struct jhead *jh, int info_only, IMFILE *ifp, unsigned &zero_after_ff);
+int ljpeg_diff (ushort *huff, getbithuff_t &getbithuff);
+ushort * ljpeg_row (int jrow, struct jhead *jh, fastbithuff_t &pump);
+void ljpeg_idct (struct jhead *jh, getbithuff_t &getbithuff);
+void ljpeg_make_lookahead (const ushort *huff, struct ljpeg_lookahead *lookahead);
 
 
 void canon_sraw_load_raw();
 void adobe_copy_pixel (unsigned row, unsigned col, ushort **rp);
+bool lossless_dng_decode_tile (unsigned trow, unsigned tcol, IMFILE *ifp, getbithuff_t &getbithuff, unsigned &zero_after_ff);
 void lossless_dng_load_raw();
 void packed_dng_load_raw();
 void deflate_dng_load_raw();
@@ -566,7 +622,7 @@ void selectCRXTrack(unsigned short maxTrack);
 int parseCR3(unsigned long long oAtomList,
              unsigned long long szAtomList, short &nesting,
              char *AtomNameStack, unsigned short &nTrack, short &TrackType);
-bool crxDecodePlane(void *p, uint32_t planeNumber);
+bool crxDecodeTile(void *p, uint32_t planeNumber, int tileNumber, int imageRow, int imageCol);
 void crxLoadDecodeLoop(void *img, int nPlanes);
 void crxConvertPlaneLineDf(void *p, int imageRow);
 void crxLoadFinalizeLoopE3(void *p, int planeHeight);
@@ -0,0 +1,194 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glibmm/checksum.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#include "demosaiccache.h"
+#include "settings.h"
+#include "../rtgui/options.h"
+
+namespace rtengine
+{
+
+namespace
+{
+
+constexpr char cacheMagic[8] = {'R', 'T', 'D', 'M', 'C', '0', '0', '1'};
+
+Glib::ustring getCacheDir()
+{
+    return Glib::build_filename(options.cacheBaseDir, "demosaic");
+}
+
+Glib::ustring getCacheFileName(const std::string& key)
+{
+    return Glib::build_filename(getCacheDir(), Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, key) + ".rtd");
+}
+
+}
+
+DemosaicCache& DemosaicCache::getInstance()
+{
+    static DemosaicCache instance;
+    return instance;
+}
+
+bool DemosaicCache::isEnabled() const
+{
+    return options.demosaicCacheSize > 0 && !options.cacheBaseDir.empty();
+}
+
+bool DemosaicCache::load(const std::string& key, array2D<float>& red, array2D<float>& green, array2D<float>& blue, double& contrastThreshold)
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    const Glib::ustring fileName = getCacheFileName(key);
+    FILE* const f = g_fopen(fileName.c_str(), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    const int W = red.getWidth();
+    const int H = red.getHeight();
+    char magic[sizeof(cacheMagic)];
+    std::int32_t size[2];
+    double threshold;
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1 && !memcmp(magic, cacheMagic, sizeof(magic))
+              && fread(size, sizeof(size), 1, f) == 1 && size[0] == W && size[1] == H
+              && fread(&threshold, sizeof(threshold), 1, f) == 1;
+
+    for (array2D<float>* plane : {&red, &green, &blue}) {
+        for (int row = 0; ok && row < H; ++row) {
+            ok = fread((*plane)[row], sizeof(float), W, f) == static_cast<size_t>(W);
+        }
+    }
+
+    fclose(f);
+
+    if (ok) {
+        contrastThreshold = threshold;
+        // the modification time is used to find the least recently used files
+        g_utime(fileName.c_str(), nullptr);
+    } else if (settings->verbose) {
+        std::cerr << "Invalid demosaic cache file " << fileName << std::endl;
+    }
+
+    return ok;
+}
+
+void DemosaicCache::store(const std::string& key, const array2D<float>& red, const array2D<float>& green, const array2D<float>& blue, double contrastThreshold)
+{
+    if (!isEnabled() || g_mkdir_with_parents(getCacheDir().c_str(), 0777) != 0) {
+        return;
+    }
+
+    // write to a temporary file first, other instances may be reading the cache
+    const Glib::ustring fileName = getCacheFileName(key);
+    const Glib::ustring tmpName = fileName + ".tmp" + std::to_string(g_random_int());
+    FILE* const f = g_fopen(tmpName.c_str(), "wb");
+
+    if (!f) {
+        return;
+    }
+
+    const int W = red.getWidth();
+    const int H = red.getHeight();
+    const std::int32_t size[2] = {W, H};
+    bool ok = fwrite(cacheMagic, sizeof(cacheMagic), 1, f) == 1 && fwrite(size, sizeof(size), 1, f) == 1
+              && fwrite(&contrastThreshold, sizeof(contrastThreshold), 1, f) == 1;
+
+    for (const array2D<float>* plane : {&red, &green, &blue}) {
+        for (int row = 0; ok && row < H; ++row) {
+            ok = fwrite((*plane)[row], sizeof(float), W, f) == static_cast<size_t>(W);
+        }
+    }
+
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || g_rename(tmpName.c_str(), fileName.c_str()) != 0) {
+        g_remove(tmpName.c_str());
+
+        if (settings->verbose) {
+            std::cerr << "Failed to write demosaic cache file " << fileName << std::endl;
+        }
+
+        return;
+    }
+
+    prune();
+}
+
+void DemosaicCache::prune()
+{
+    MyMutex::MyLock lock(mutex);
+
+    struct Entry {
+        std::string name;
+        std::uint64_t size;
+        std::int64_t time;
+    };
+
+    const Glib::ustring dir = getCacheDir();
+    std::vector<Entry> entries;
+    std::uint64_t totalSize = 0;
+
+    try {
+        for (const auto& name : Glib::Dir(dir)) {
+            GStatBuf stat;
+            const std::string path = Glib::build_filename(dir, name);
+
+            if (g_stat(path.c_str(), &stat) == 0) {
+                entries.push_back({path, static_cast<std::uint64_t>(stat.st_size), static_cast<std::int64_t>(stat.st_mtime)});
+                totalSize += stat.st_size;
+            }
+        }
+    } catch (Glib::Exception&) {
+        return;
+    }
+
+    const std::uint64_t maxSize = static_cast<std::uint64_t>(options.demosaicCacheSize) << 20;
+
+    if (totalSize <= maxSize) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.time < b.time;
+    });
+
+    // the newest file is kept even if it's bigger than the limit on its own, it has just been used
+    for (size_t i = 0; i + 1 < entries.size() && totalSize > maxSize; ++i) {
+        if (g_remove(entries[i].name.c_str()) == 0) {
+            totalSize -= entries[i].size;
+        }
+    }
+}
+
+}
@@ -0,0 +1,54 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <string>
+
+#include "array2D.h"
+#include "noncopyable.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+/*
+  On disk cache of the output of RawImageSource::demosaic(), enabled by setting Options::demosaicCacheSize (MiB).
+  The red, green and blue planes are stored uncompressed in the "demosaic" folder of the cache, the least recently
+  used files are removed when the folder grows beyond the size limit. The key is built by the caller and has to
+  identify the demosaic input (see RawImageSource::getDemosaicCacheKey()).
+*/
+class DemosaicCache final :
+    public NonCopyable
+{
+public:
+    static DemosaicCache& getInstance();
+
+    bool isEnabled() const;
+
+    // Returns false if there's no entry for the key or if it has another size than the planes
+    bool load(const std::string& key, array2D<float>& red, array2D<float>& green, array2D<float>& blue, double& contrastThreshold);
+    void store(const std::string& key, const array2D<float>& red, const array2D<float>& green, const array2D<float>& blue, double contrastThreshold);
+
+private:
+    DemosaicCache() = default;
+
+    void prune();
+
+    MyMutex mutex; // serializes the pruning
+};
+
+}
@@ -26,6 +26,7 @@
 #include "dfmanager.h"
 #include "../rtgui/options.h"
 #include "rawimage.h"
+#include "rawtemplate.h"
 #include "imagedata.h"
 #include "utils.h"
 
@@ -136,71 +137,8 @@ std::vector<badPix>& dfInfo::getHotPixels()
  */
 void dfInfo::updateRawImage()
 {
-    typedef unsigned int acc_t;
-
     if( !pathNames.empty() ) {
-        std::list<Glib::ustring>::iterator iName = pathNames.begin();
-        ri = new RawImage(*iName); // First file used also for extra pixels information (width,height, shutter, filters etc.. )
-
-        if( ri->loadRaw(true)) {
-            delete ri;
-            ri = nullptr;
-        } else {
-            int H = ri->get_height();
-            int W = ri->get_width();
-            ri->compress_image(0);
-            int rSize = W * ((ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS) ? 1 : 3);
-            acc_t **acc = new acc_t*[H];
-
-            for( int row = 0; row < H; row++) {
-                acc[row] = new acc_t[rSize ];
-            }
-
-            // copy first image into accumulators
-            for (int row = 0; row < H; row++)
-                for (int col = 0; col < rSize; col++) {
-                    acc[row][col] = ri->data[row][col];
-                }
-
-            int nFiles = 1; // First file data already loaded
-
-            for( ++iName; iName != pathNames.end(); ++iName) {
-                RawImage* temp = new RawImage(*iName);
-
-                if( !temp->loadRaw(true)) {
-                    temp->compress_image(0);     //\ TODO would be better working on original, because is temporary
-                    nFiles++;
-
-                    if( ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS ) {
-                        for( int row = 0; row < H; row++) {
-                            for( int col = 0; col < W; col++) {
-                                acc[row][col] += temp->data[row][col];
-                            }
-                        }
-                    } else {
-                        for( int row = 0; row < H; row++) {
-                            for( int col = 0; col < W; col++) {
-                                acc[row][3 * col + 0] += temp->data[row][3 * col + 0];
-                                acc[row][3 * col + 1] += temp->data[row][3 * col + 1];
-                                acc[row][3 * col + 2] += temp->data[row][3 * col + 2];
-                            }
-                        }
-                    }
-                }
-
-                delete temp;
-            }
-
-            for (int row = 0; row < H; row++) {
-                for (int col = 0; col < rSize; col++) {
-                    ri->data[row][col] = acc[row][col] / nFiles;
-                }
-
-                delete [] acc[row];
-            }
-
-            delete [] acc;
-        }
+        ri = loadRawTemplate(pathNames);
     } else {
         ri = new RawImage(pathname);
 
@@ -275,6 +213,24 @@ void dfInfo::updateBadPixelList( RawImage *df )
 // ************************* class DFManager *********************************
 
 void DFManager::init(const Glib::ustring& pathname)
+{
+    MyMutex::MyLock lock(scanMutex);
+
+    pendingPath = pathname;
+    initialized = false;
+}
+
+void DFManager::ensureScanned()
+{
+    MyMutex::MyLock lock(scanMutex);
+
+    if (!initialized) {
+        initialized = true;
+        scan(pendingPath);
+    }
+}
+
+void DFManager::scan(const Glib::ustring& pathname)
 {
     if (pathname.empty()) {
         return;
@@ -420,6 +376,8 @@ dfInfo* DFManager::addFileInfo (const Glib::ustring& filename, bool pool)
 
 void DFManager::getStat( int &totFiles, int &totTemplates)
 {
+    ensureScanned();
+
     totFiles = 0;
     totTemplates = 0;
 
@@ -482,6 +440,8 @@ dfInfo* DFManager::find( const std::string &mak, const std::string &mod, int iso
 
 RawImage* DFManager::searchDarkFrame( const std::string &mak, const std::string &mod, int iso, double shut, time_t t )
 {
+    ensureScanned();
+
     dfInfo *df = find( ((Glib::ustring)mak).uppercase(), ((Glib::ustring)mod).uppercase(), iso, shut, t );
 
     if( df ) {
@@ -493,6 +453,8 @@ RawImage* DFManager::searchDarkFrame( const std::string &mak, const std::string
 
 RawImage* DFManager::searchDarkFrame( const Glib::ustring filename )
 {
+    ensureScanned();
+
     for ( dfList_t::iterator iter = dfList.begin(); iter != dfList.end(); ++iter ) {
         if( iter->second.pathname.compare( filename ) == 0  ) {
             return iter->second.getRawImage();
@@ -509,6 +471,8 @@ RawImage* DFManager::searchDarkFrame( const Glib::ustring filename )
 }
 std::vector<badPix> *DFManager::getHotPixels ( const Glib::ustring filename )
 {
+    ensureScanned();
+
     for ( dfList_t::iterator iter = dfList.begin(); iter != dfList.end(); ++iter ) {
         if( iter->second.pathname.compare( filename ) == 0  ) {
             return &iter->second.getHotPixels();
@@ -519,6 +483,8 @@ std::vector<badPix> *DFManager::getHotPixels ( const Glib::ustring filename )
 }
 std::vector<badPix> *DFManager::getHotPixels ( const std::string &mak, const std::string &mod, int iso, double shut, time_t t )
 {
+    ensureScanned();
+
     dfInfo *df = find( ((Glib::ustring)mak).uppercase(), ((Glib::ustring)mod).uppercase(), iso, shut, t );
 
     if( df ) {
@@ -592,6 +558,8 @@ int DFManager::scanBadPixelsFile( Glib::ustring filename )
 
 std::vector<badPix> *DFManager::getBadPixels ( const std::string &mak, const std::string &mod, const std::string &serial)
 {
+    ensureScanned();
+
     bpList_t::iterator iter;
     bool found = false;
 
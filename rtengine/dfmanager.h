@@ -25,6 +25,8 @@
 
 #include <glibmm/ustring.h>
 
+#include "../rtgui/threadutils.h"
+
 #include "pixelsmap.h"
 
 namespace rtengine
@@ -94,8 +96,13 @@ protected:
     typedef std::map<std::string, std::vector<badPix> > bpList_t;
     dfList_t dfList;
     bpList_t bpList;
-    bool initialized;
+    bool initialized = false;
     Glib::ustring currentPath;
+    // the folder is scanned on first use, init() only remembers it
+    Glib::ustring pendingPath;
+    MyMutex scanMutex;
+    void scan(const Glib::ustring &pathname);
+    void ensureScanned();
     dfInfo *addFileInfo(const Glib::ustring &filename, bool pool = true );
     dfInfo *find( const std::string &mak, const std::string &mod, int isospeed, double shut, time_t t );
     int scanBadPixelsFile( Glib::ustring filename );
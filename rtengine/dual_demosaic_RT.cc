@@ -65,8 +65,6 @@ void RawImageSource::dual_demosaic_RT(bool isBayer, const procparams::RAWParams
         return;
     }
 
-    array2D<float> L(winw, winh);
-
     if (isBayer) {
         if (raw.bayersensor.method == procparams::RAWParams::BayerSensor::getMethodString(procparams::RAWParams::BayerSensor::Method::AMAZEBILINEAR) ||
             raw.bayersensor.method == procparams::RAWParams::BayerSensor::getMethodString(procparams::RAWParams::BayerSensor::Method::AMAZEVNG4) ||
@@ -93,19 +91,21 @@ void RawImageSource::dual_demosaic_RT(bool isBayer, const procparams::RAWParams
                                 { 0.019334, 0.119193, 0.950227 }
                                 };
 
-#ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic,16)
-#endif
-    for(int i = 0; i < winh; ++i) {
-        Color::RGB2L(red[i], green[i], blue[i], L[i], xyz_rgb, winw);
-    }
-
     // calculate contrast based blend factors to use flat demosaicer in regions with low contrast
-    JaggedArray<float> blend(winw, winh);
+    // red, green and blue are not changed before the mask is complete, so the luminance is computed per strip
+    const auto getLuminance = [&](int row, int col, int width, float* luminance) {
+        Color::RGB2L(red[row] + col, green[row] + col, blue[row] + col, luminance, xyz_rgb, width);
+    };
+
     float contrastf = contrast / 100.0;
 
-    buildBlendMask(L, blend, winw, winh, contrastf, autoContrast);
-    contrast = contrastf * 100.f;
+    if (autoContrast) {
+        contrastf = calcAutoContrastThresholdTiled(getLuminance, winw, winh);
+        contrast = contrastf * 100.f;
+    }
+
+    JaggedArray<float> blend(winw, winh);
+    buildBlendMaskTiled(getLuminance, blend, winw, winh, contrastf);
 
     if (isBayer) {
         if (raw.bayersensor.method == procparams::RAWParams::BayerSensor::getMethodString(procparams::RAWParams::BayerSensor::Method::AMAZEBILINEAR) ||
@@ -113,7 +113,7 @@ void RawImageSource::dual_demosaic_RT(bool isBayer, const procparams::RAWParams
             raw.bayersensor.method == procparams::RAWParams::BayerSensor::getMethodString(procparams::RAWParams::BayerSensor::Method::DCBBILINEAR)) {
             bayer_bilinear_demosaic(blend, rawData, red, green, blue);
         } else {
-            array2D<float>& redTmp = L; // L is not needed anymore => reuse it
+            array2D<float> redTmp(winw, winh);
             array2D<float> greenTmp(winw, winh);
             array2D<float> blueTmp(winw, winh);
             vng4_demosaic(rawData, redTmp, greenTmp, blueTmp);
@@ -23,6 +23,7 @@
 #include "ffmanager.h"
 #include "../rtgui/options.h"
 #include "rawimage.h"
+#include "rawtemplate.h"
 #include "imagedata.h"
 #include "median.h"
 #include "utils.h"
@@ -131,72 +132,10 @@ RawImage* ffInfo::getRawImage()
  */
 void ffInfo::updateRawImage()
 {
-    typedef unsigned int acc_t;
-
     // averaging of flatfields if more than one is found matching the same key.
     // this may not be necessary, as flatfield is further blurred before being applied to the processed image.
     if( !pathNames.empty() ) {
-        std::list<Glib::ustring>::iterator iName = pathNames.begin();
-        ri = new RawImage(*iName); // First file used also for extra pixels information (width, height, shutter, filters etc.. )
-        if( ri->loadRaw(true)) {
-            delete ri;
-            ri = nullptr;
-        } else {
-            int H = ri->get_height();
-            int W = ri->get_width();
-            ri->compress_image(0);
-            int rSize = W * ((ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS || ri->get_colors() == 1) ? 1 : 3);
-            acc_t **acc = new acc_t*[H];
-
-            for( int row = 0; row < H; row++) {
-                acc[row] = new acc_t[rSize ];
-            }
-
-            // copy first image into accumulators
-            for (int row = 0; row < H; row++)
-                for (int col = 0; col < rSize; col++) {
-                    acc[row][col] = ri->data[row][col];
-                }
-
-            int nFiles = 1; // First file data already loaded
-
-            for( ++iName; iName != pathNames.end(); ++iName) {
-                RawImage* temp = new RawImage(*iName);
-
-                if( !temp->loadRaw(true)) {
-                    temp->compress_image(0);     //\ TODO would be better working on original, because is temporary
-                    nFiles++;
-
-                    if( ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS || ri->get_colors() == 1 ) {
-                        for( int row = 0; row < H; row++) {
-                            for( int col = 0; col < W; col++) {
-                                acc[row][col] += temp->data[row][col];
-                            }
-                        }
-                    } else {
-                        for( int row = 0; row < H; row++) {
-                            for( int col = 0; col < W; col++) {
-                                acc[row][3 * col + 0] += temp->data[row][3 * col + 0];
-                                acc[row][3 * col + 1] += temp->data[row][3 * col + 1];
-                                acc[row][3 * col + 2] += temp->data[row][3 * col + 2];
-                            }
-                        }
-                    }
-                }
-
-                delete temp;
-            }
-
-            for (int row = 0; row < H; row++) {
-                for (int col = 0; col < rSize; col++) {
-                    ri->data[row][col] = acc[row][col] / nFiles;
-                }
-
-                delete [] acc[row];
-            }
-
-            delete [] acc;
-        }
+        ri = loadRawTemplate(pathNames);
     } else {
         ri = new RawImage(pathname);
         if( ri->loadRaw(true)) {
@@ -239,6 +178,24 @@ void ffInfo::updateRawImage()
 // ************************* class FFManager *********************************
 
 void FFManager::init(const Glib::ustring& pathname)
+{
+    MyMutex::MyLock lock(scanMutex);
+
+    pendingPath = pathname;
+    initialized = false;
+}
+
+void FFManager::ensureScanned()
+{
+    MyMutex::MyLock lock(scanMutex);
+
+    if (!initialized) {
+        initialized = true;
+        scan(pendingPath);
+    }
+}
+
+void FFManager::scan(const Glib::ustring& pathname)
 {
     if (pathname.empty()) {
         return;
@@ -372,6 +329,8 @@ ffInfo* FFManager::addFileInfo (const Glib::ustring& filename, bool pool)
 
 void FFManager::getStat( int &totFiles, int &totTemplates)
 {
+    ensureScanned();
+
     totFiles = 0;
     totTemplates = 0;
 
@@ -434,6 +393,8 @@ ffInfo* FFManager::find( const std::string &mak, const std::string &mod, const s
 
 RawImage* FFManager::searchFlatField( const std::string &mak, const std::string &mod, const std::string &len, double focal, double apert, time_t t )
 {
+    ensureScanned();
+
     ffInfo *ff = find( mak, mod, len, focal, apert, t );
 
     if( ff ) {
@@ -445,6 +406,8 @@ RawImage* FFManager::searchFlatField( const std::string &mak, const std::string
 
 RawImage* FFManager::searchFlatField( const Glib::ustring filename )
 {
+    ensureScanned();
+
     for ( ffList_t::iterator iter = ffList.begin(); iter != ffList.end(); ++iter ) {
         if( iter->second.pathname.compare( filename ) == 0  ) {
             return iter->second.getRawImage();
@@ -25,6 +25,8 @@
 
 #include <glibmm/ustring.h>
 
+#include "../rtgui/threadutils.h"
+
 namespace rtengine
 {
 
@@ -86,8 +88,13 @@ public:
 protected:
     typedef std::multimap<std::string, ffInfo> ffList_t;
     ffList_t ffList;
-    bool initialized;
+    bool initialized = false;
     Glib::ustring currentPath;
+    // the folder is scanned on first use, init() only remembers it
+    Glib::ustring pendingPath;
+    MyMutex scanMutex;
+    void scan(const Glib::ustring &pathname);
+    void ensureScanned();
     ffInfo *addFileInfo(const Glib::ustring &filename, bool pool = true );
     ffInfo *find( const std::string &mak, const std::string &mod, const std::string &len, double focal, double apert, time_t t );
 };
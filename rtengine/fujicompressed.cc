@@ -18,8 +18,54 @@ it under the terms of the one of three licenses as you choose:
 
  */
 
+#include <memory>
+#include <vector>
+
+#include "../rtgui/threadutils.h"
+
 namespace {
 
+// Line and read buffers of one strip decoder
+struct FujiStripBuffers {
+    std::vector<unsigned short> lines;
+    std::vector<unsigned char> input;
+};
+
+// Keeps the strip buffers of finished strips for the next strips and files, so that
+// batches of RAFs don't reallocate them for every strip of every file.
+class FujiStripBufferPool
+{
+public:
+    static FujiStripBufferPool& getInstance()
+    {
+        static FujiStripBufferPool instance;
+        return instance;
+    }
+
+    std::unique_ptr<FujiStripBuffers> acquire()
+    {
+        MyMutex::MyLock lock(mutex);
+
+        if (buffers.empty()) {
+            return std::unique_ptr<FujiStripBuffers>(new FujiStripBuffers);
+        }
+
+        std::unique_ptr<FujiStripBuffers> result = std::move(buffers.back());
+        buffers.pop_back();
+        return result;
+    }
+
+    void release(std::unique_ptr<FujiStripBuffers> strip)
+    {
+        MyMutex::MyLock lock(mutex);
+        buffers.push_back(std::move(strip));
+    }
+
+private:
+    MyMutex mutex;
+    std::vector<std::unique_ptr<FujiStripBuffers>> buffers;
+};
+
 int bitDiff (int value1, int value2)
 {
     int decBits = 0;
@@ -133,11 +179,9 @@ void CLASS fuji_fill_buffer (struct fuji_compressed_block *info)
     }
 }
 
+// info->linealloc (and info->cur_buf without MYFILE_MMAP) have to be provided by the caller
 void CLASS init_fuji_block (struct fuji_compressed_block* info, const struct fuji_compressed_params *params, INT64 raw_offset, unsigned dsize)
 {
-    info->linealloc = (ushort*)calloc (sizeof (ushort), _ltotal * (params->line_width + 2));
-    merror (info->linealloc, "init_fuji_block()");
-
     info->input = ifp;
     INT64 fsize = info->input->size;
     info->max_read_size = std::min (unsigned (fsize - raw_offset), dsize + 16); // Data size may be incorrect?
@@ -149,11 +193,6 @@ void CLASS init_fuji_block (struct fuji_compressed_block* info, const struct fuj
         info->linebuf[i] = info->linebuf[i - 1] + params->line_width + 2;
     }
 
-    // init buffer
-#ifndef MYFILE_MMAP
-    info->cur_buf = (uchar*)malloc (FUJI_BUF_SIZE);
-    merror (info->cur_buf, "init_fuji_block()");
-#endif
     info->cur_bit = 0;
     info->cur_pos = 0;
     info->cur_buf_offset = raw_offset;
@@ -852,6 +891,16 @@ void CLASS fuji_decode_strip (const struct fuji_compressed_params* info_common,
     unsigned line_size;
     struct fuji_compressed_block info;
 
+    FujiStripBufferPool& pool = FujiStripBufferPool::getInstance();
+    std::unique_ptr<FujiStripBuffers> buffers = pool.acquire();
+    // the line buffers have to start zeroed, assign() keeps the capacity of a reused buffer
+    buffers->lines.assign(_ltotal * (info_common->line_width + 2), 0);
+    info.linealloc = buffers->lines.data();
+#ifndef MYFILE_MMAP
+    buffers->input.resize(FUJI_BUF_SIZE);
+    info.cur_buf = buffers->input.data();
+#endif
+
     init_fuji_block (&info, info_common, raw_offset, dsize);
     line_size = sizeof (ushort) * (info_common->line_width + 2);
 
@@ -893,11 +942,7 @@ void CLASS fuji_decode_strip (const struct fuji_compressed_params* info_common,
         }
     }
 
-    // release data
-    free (info.linealloc);
-#ifndef MYFILE_MMAP
-    free (info.cur_buf);
-#endif
+    pool.release(std::move(buffers));
 }
 
 static unsigned sgetn (int n, uchar *s)
@@ -961,7 +1006,10 @@ void CLASS fuji_decode_loop (const struct fuji_compressed_params* common_info, i
 {
 
 #ifdef _OPENMP
-    #pragma omp parallel for schedule(dynamic,1) // dynamic scheduling is faster if count > number of cores (e.g. count for GFX 50S is 12)
+    // The strips are sequential streams that can't be split further, so don't start more threads than
+    // there are strips: idle threads would only be taken away from the images processed concurrently.
+    const int threads = std::max(1, std::min(count, omp_get_max_threads()));
+    #pragma omp parallel for schedule(dynamic,1) num_threads(threads) // dynamic scheduling is faster if count > number of cores (e.g. count for GFX 50S is 12)
 #endif
 
     for (int cur_block = 0; cur_block < count ; cur_block++) {
@@ -25,6 +25,7 @@
 #include "boxblur.h"
 #include "opthelper.h"
 #include "rt_math.h"
+#include "simdkernels.h"
 
 namespace
 {
@@ -699,6 +700,16 @@ template<class T> void gaussVerticalSse (T** src, T** dst, const int W, const in
             M[i][j] /= (1.0 + b1 - b2 + b3) * (1.0 - b1 - b2 - b3);
         }
 
+    if (const rtengine::simd::Kernels* kernels = rtengine::simd::getKernels()) {
+        const float Mf[3][3] = {
+            {static_cast<float>(M[0][0]), static_cast<float>(M[0][1]), static_cast<float>(M[0][2])},
+            {static_cast<float>(M[1][0]), static_cast<float>(M[1][1]), static_cast<float>(M[1][2])},
+            {static_cast<float>(M[2][0]), static_cast<float>(M[2][1]), static_cast<float>(M[2][2])}
+        };
+        kernels->gaussVertical(src, dst, W, H, B, b1, b2, b3, Mf);
+        return;
+    }
+
     float tmp[H][8] ALIGNED16;
     vfloat Rv;
     vfloat Tv, Tm2v, Tm3v;
@@ -27,6 +27,7 @@
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <vector>
 
 #include "array2D.h"
 #include "opthelper.h"
@@ -291,6 +292,106 @@ void boxblur_resamp(const float* const* src, float** dst, float** temp, int H, i
     }
 }
 
+struct ClippedRegion {
+    int minx;
+    int miny;
+    int maxx;
+    int maxy;
+};
+
+// Returns the bounding boxes of the clipped areas, grown by border and clamped to the image.
+// Clipped areas which are too close to get separate boxes are joined, so the boxes don't overlap.
+std::vector<ClippedRegion> findClippedRegions(const float* const* red, const float* const* green, const float* const* blue, const float max_f[3], int width, int height, int border)
+{
+    constexpr int tileSize = 64;
+    const int tilesW = (width + tileSize - 1) / tileSize;
+    const int tilesH = (height + tileSize - 1) / tileSize;
+
+    // exact extent of the clipped pixels per tile, empty tiles have minx > maxx
+    std::vector<ClippedRegion> tiles(tilesW * tilesH, {width, height, -1, -1});
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (int ty = 0; ty < tilesH; ++ty) {
+        for (int i = ty * tileSize; i < std::min((ty + 1) * tileSize, height); ++i) {
+            for (int j = 0; j < width; ++j) {
+                if (red[i][j] >= max_f[0] || green[i][j] >= max_f[1] || blue[i][j] >= max_f[2]) {
+                    ClippedRegion &tile = tiles[ty * tilesW + j / tileSize];
+                    tile.minx = std::min(tile.minx, j);
+                    tile.maxx = std::max(tile.maxx, j);
+                    tile.miny = std::min(tile.miny, i);
+                    tile.maxy = std::max(tile.maxy, i);
+                }
+            }
+        }
+    }
+
+    // group the clipped tiles whose grown boxes would overlap
+    const int radius = 2 * border / tileSize + 1;
+    std::vector<bool> visited(tiles.size(), false);
+    std::vector<int> stack;
+    std::vector<ClippedRegion> regions;
+
+    for (size_t t = 0; t < tiles.size(); ++t) {
+        if (visited[t] || tiles[t].minx > tiles[t].maxx) {
+            continue;
+        }
+
+        ClippedRegion region = tiles[t];
+        visited[t] = true;
+        stack.push_back(t);
+
+        while (!stack.empty()) {
+            const int ty = stack.back() / tilesW;
+            const int tx = stack.back() % tilesW;
+            stack.pop_back();
+
+            for (int ny = std::max(ty - radius, 0); ny <= std::min(ty + radius, tilesH - 1); ++ny) {
+                for (int nx = std::max(tx - radius, 0); nx <= std::min(tx + radius, tilesW - 1); ++nx) {
+                    const int n = ny * tilesW + nx;
+
+                    if (!visited[n] && tiles[n].minx <= tiles[n].maxx) {
+                        visited[n] = true;
+                        stack.push_back(n);
+                        region.minx = std::min(region.minx, tiles[n].minx);
+                        region.maxx = std::max(region.maxx, tiles[n].maxx);
+                        region.miny = std::min(region.miny, tiles[n].miny);
+                        region.maxy = std::max(region.maxy, tiles[n].maxy);
+                    }
+                }
+            }
+        }
+
+        region.minx = std::max(0, region.minx - border);
+        region.miny = std::max(0, region.miny - border);
+        region.maxx = std::min(width - 1, region.maxx + border);
+        region.maxy = std::min(height - 1, region.maxy + border);
+        regions.push_back(region);
+    }
+
+    // the boxes of groups with interleaved extents can still overlap, join them
+    for (bool joined = true; joined;) {
+        joined = false;
+
+        for (size_t a = 0; a < regions.size(); ++a) {
+            for (size_t b = a + 1; b < regions.size(); ++b) {
+                if (regions[a].minx <= regions[b].maxx && regions[b].minx <= regions[a].maxx && regions[a].miny <= regions[b].maxy && regions[b].miny <= regions[a].maxy) {
+                    regions[a].minx = std::min(regions[a].minx, regions[b].minx);
+                    regions[a].maxx = std::max(regions[a].maxx, regions[b].maxx);
+                    regions[a].miny = std::min(regions[a].miny, regions[b].miny);
+                    regions[a].maxy = std::max(regions[a].maxy, regions[b].maxy);
+                    regions.erase(regions.begin() + b);
+                    joined = true;
+                    --b;
+                }
+            }
+        }
+    }
+
+    return regions;
+}
+
 }
 
 namespace rtengine
@@ -299,28 +400,15 @@ extern const Settings *settings;
 using namespace procparams;
     const ProcParams params;
 
-void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue, int blur)
-{  
-  //  BENCHFUN
-    double progress = 0.0;
-
-    if (plistener) {
-        plistener->setProgressStr("PROGRESSBAR_HLREC");
-        plistener->setProgress(progress);
-    }
-
-    const int height = H;
-    const int width = W;
-
+// Reconstructs the highlights of one clipped region. Only the pixels inside the region box are read and written.
+static void reconstructRegion(float** red, float** green, float** blue, int blur, const ClippedRegion &region,
+                              const float max_f[3], const float thresh[3], const float medFactor[3], float whitept, float clippt, float blendpt,
+                              ProgressListener* plistener, double &progress, double progressScale)
+{
     constexpr int range = 2;
     constexpr int pitch = 4;
-
-    constexpr float threshpct = 0.25f;
-    constexpr float maxpct = 0.95f;
     constexpr float epsilon = 0.00001f;
 
-    //for blend algorithm:
-    constexpr float blendthresh = 1.0;
     // Transform matrixes rgb>lab and back
     constexpr float trans[3][3] = {
         {1.f, 1.f, 1.f},
@@ -333,102 +421,10 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
         {1.f, 0.f, 1.f}
     };
 
-    if (settings->verbose) {
-        for (int c = 0; c < 3; ++c) {
-            printf("chmax[%d] : %f\tclmax[%d] : %f\tratio[%d] : %f\n", c, static_cast<double>(chmax[c]), c, static_cast<double>(clmax[c]), c, static_cast<double>(chmax[c] / clmax[c]));
-        }
-    }
-
-    float factor[3];
-
-    for (int c = 0; c < 3; ++c) {
-        factor[c] = chmax[c] / clmax[c];
-    }
-
-    const float minFactor = min(factor[0], factor[1], factor[2]);
-
-    if (minFactor > 1.f) { // all 3 channels clipped
-        // calculate clip factor per channel
-        for (int c = 0; c < 3; ++c) {
-            factor[c] /= minFactor;
-        }
-
-        // get max clip factor
-        int maxpos = 0;
-        float maxValNew = 0.f;
-
-        for (int c = 0; c < 3; ++c) {
-            if (chmax[c] / factor[c] > maxValNew) {
-                maxValNew = chmax[c] / factor[c];
-                maxpos = c;
-            }
-        }
-
-        const float clipFactor = clmax[maxpos] / maxValNew;
-
-        if (clipFactor < maxpct) {
-            // if max clipFactor < maxpct (0.95) adjust per channel factors
-            for (int c = 0; c < 3; ++c) {
-                factor[c] *= (maxpct / clipFactor);
-            }
-        }
-    } else {
-        factor[0] = factor[1] = factor[2] = 1.f;
-    }
-
-    if (settings->verbose) {
-        for (int c = 0; c < 3; ++c) {
-            printf("correction factor[%d] : %f\n", c, static_cast<double>(factor[c]));
-        }
-    }
-
-    float max_f[3];
-    float thresh[3];
-
-    for (int c = 0; c < 3; ++c) {
-        thresh[c] = chmax[c] * threshpct / factor[c];
-        max_f[c] = chmax[c] * maxpct / factor[c];
-    }
-
-    const float whitept = max(max_f[0], max_f[1], max_f[2]);
-    const float clippt  = min(max_f[0], max_f[1], max_f[2]);
-    const float medpt   = max_f[0] + max_f[1] + max_f[2] - whitept - clippt;
-    const float blendpt = blendthresh * clippt;
-
-    float medFactor[3];
-
-    for (int c = 0; c < 3; ++c) {
-        medFactor[c] = max(1.0f, max_f[c] / medpt) / -blendpt;
-    }
-
-    int minx = width - 1;
-    int maxx = 0;
-    int miny = height - 1;
-    int maxy = 0;
-
-#ifdef _OPENMP
-    #pragma omp parallel for reduction(min:minx,miny) reduction(max:maxx,maxy) schedule(dynamic, 16)
-#endif
-    for (int i = 0; i < height; ++i) {
-        for (int j = 0; j< width; ++j) {
-            if (red[i][j] >= max_f[0] || green[i][j] >= max_f[1] || blue[i][j] >= max_f[2]) {
-                minx = std::min(minx, j);
-                maxx = std::max(maxx, j);
-                miny = std::min(miny, i);
-                maxy = std::max(maxy, i);
-            }
-        }
-    }
-
-    if (minx > maxx || miny > maxy) { // nothing to reconstruct
-        return;
-    }
-
-    constexpr int blurBorder = 256;
-    minx = std::max(0, minx - blurBorder);
-    miny = std::max(0, miny - blurBorder);
-    maxx = std::min(width - 1, maxx + blurBorder);
-    maxy = std::min(height - 1, maxy + blurBorder);
+    const int minx = region.minx;
+    const int miny = region.miny;
+    const int maxx = region.maxx;
+    const int maxy = region.maxy;
     const int blurWidth = maxx - minx + 1;
     const int blurHeight = maxy - miny + 1;
     const int bufferWidth = blurWidth + ((16 - (blurWidth % 16)) & 15);
@@ -442,7 +438,7 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
     boxblur2(blue, channelblur[2], temp, miny, minx, blurHeight, blurWidth, bufferWidth, 4);
  
     if (plistener) {
-        progress += 0.07;
+        progress += 0.07 * progressScale;
         plistener->setProgress(progress);
     }
 
@@ -461,14 +457,14 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
     }
 
     if (plistener) {
-        progress += 0.05;
+        progress += 0.05 * progressScale;
         plistener->setProgress(progress);
     }
 
     multi_array2D<float, 4> hilite_full(bufferWidth, blurHeight, ARRAY2D_CLEAR_DATA, 32);
 
     if (plistener) {
-        progress += 0.05;
+        progress += 0.05 * progressScale;
         plistener->setProgress(progress);
     }
 
@@ -506,7 +502,7 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
     const float hipass_ave = 2.0 * hipass_sum / (hipass_norm + static_cast<double>(epsilon));
 
     if (plistener) {
-        progress += 0.05;
+        progress += 0.05 * progressScale;
         plistener->setProgress(progress);
     }
 
@@ -518,7 +514,7 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
     temp.free(); // free temporary buffer
 
     if (plistener) {
-        progress += 0.07;
+        progress += 0.07 * progressScale;
         plistener->setProgress(progress);
     }
 
@@ -555,7 +551,7 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
         boxblur_resamp(hilite_full[m], hilite[m], temp2, blurHeight, blurWidth, range, pitch);
 
         if (plistener) {
-            progress += 0.05;
+            progress += 0.05 * progressScale;
             plistener->setProgress(progress);
         }
     }
@@ -572,7 +568,7 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
     multi_array2D<float, 4> hilite_dir4(hfh, hfw, ARRAY2D_CLEAR_DATA, 64);
 
     if (plistener) {
-        progress += 0.05;
+        progress += 0.05 * progressScale;
         plistener->setProgress(progress);
     }
 
@@ -696,7 +692,7 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
         }
     }
     if (plistener) {
-        progress += 0.05;
+        progress += 0.05 * progressScale;
         plistener->setProgress(progress);
     }
 
@@ -768,7 +764,7 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
         }
     }
     if (plistener) {
-        progress += 0.05;
+        progress += 0.05 * progressScale;
         plistener->setProgress(progress);
     }
 
@@ -816,7 +812,7 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
     }
 
     if (plistener) {
-        progress += 0.05;
+        progress += 0.05 * progressScale;
         plistener->setProgress(progress);
     }
 
@@ -838,7 +834,7 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
     }
 
     if (plistener) {
-        progress += 0.05;
+        progress += 0.05 * progressScale;
         plistener->setProgress(progress);
     }
 
@@ -909,7 +905,7 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
     }
 
     if (plistener) {
-        progress += 0.05;
+        progress += 0.05 * progressScale;
         plistener->setProgress(progress);
     }
 
@@ -1163,10 +1159,10 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
 
     if (blur > 0) {
         if (plistener) {
-            progress += 0.05;
+            progress += 0.05 * progressScale;
             plistener->setProgress(progress);
         }
-        blur = rtengine::LIM(blur - 1, 0, 3);
+        const int blurIndex = rtengine::LIM(blur - 1, 0, 3);
 
         constexpr float vals[4][3] = {{4.0f, 0.3f, 0.3f},
                                   //    {3.5f, 0.5f, 0.2f},
@@ -1175,29 +1171,29 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
                                       {2.0f, 3.0f, 0.001f}
                                      };
 
-        const float rad1 = vals[blur][0];
-        const float rad2 = vals[blur][1];
-        const float th = vals[blur][2];
+        const float rad1 = vals[blurIndex][0];
+        const float rad2 = vals[blurIndex][1];
+        const float th = vals[blurIndex][2];
 
         guidedFilter(guide, mask, mask, rad1, th, true, 1);
         if (plistener) {
-            progress += 0.03;
+            progress += 0.03 * progressScale;
             plistener->setProgress(progress);
         }
-        if (blur > 0) { //no use of 2nd guidedFilter if Blur = 0 (slider to 1)..speed-up and very small differences.
+        if (blurIndex > 0) { //no use of 2nd guidedFilter if Blur = 0 (slider to 1)..speed-up and very small differences.
             guidedFilter(guide, rbuf, rbuf, rad2, 0.01f * 65535.f, true, 1);
             if (plistener) {
-                progress += 0.03;
+                progress += 0.03 * progressScale;
                 plistener->setProgress(progress);
             }
             guidedFilter(guide, gbuf, gbuf, rad2, 0.01f * 65535.f, true, 1);
             if (plistener) {
-                progress += 0.03;
+                progress += 0.03 * progressScale;
                 plistener->setProgress(progress);
             }
             guidedFilter(guide, bbuf, bbuf, rad2, 0.01f * 65535.f, true, 1);
             if (plistener) {
-                progress += 0.03;
+                progress += 0.03 * progressScale;
                 plistener->setProgress(progress);
             }
         }
@@ -1219,6 +1215,110 @@ void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue
             }
         }
     }
+}
+
+void RawImageSource::HLRecovery_inpaint(float** red, float** green, float** blue, int blur)
+{  
+  //  BENCHFUN
+    double progress = 0.0;
+
+    if (plistener) {
+        plistener->setProgressStr("PROGRESSBAR_HLREC");
+        plistener->setProgress(progress);
+    }
+
+    const int height = H;
+    const int width = W;
+
+    constexpr float threshpct = 0.25f;
+    constexpr float maxpct = 0.95f;
+
+    //for blend algorithm:
+    constexpr float blendthresh = 1.0;
+
+    if (settings->verbose) {
+        for (int c = 0; c < 3; ++c) {
+            printf("chmax[%d] : %f\tclmax[%d] : %f\tratio[%d] : %f\n", c, static_cast<double>(chmax[c]), c, static_cast<double>(clmax[c]), c, static_cast<double>(chmax[c] / clmax[c]));
+        }
+    }
+
+    float factor[3];
+
+    for (int c = 0; c < 3; ++c) {
+        factor[c] = chmax[c] / clmax[c];
+    }
+
+    const float minFactor = min(factor[0], factor[1], factor[2]);
+
+    if (minFactor > 1.f) { // all 3 channels clipped
+        // calculate clip factor per channel
+        for (int c = 0; c < 3; ++c) {
+            factor[c] /= minFactor;
+        }
+
+        // get max clip factor
+        int maxpos = 0;
+        float maxValNew = 0.f;
+
+        for (int c = 0; c < 3; ++c) {
+            if (chmax[c] / factor[c] > maxValNew) {
+                maxValNew = chmax[c] / factor[c];
+                maxpos = c;
+            }
+        }
+
+        const float clipFactor = clmax[maxpos] / maxValNew;
+
+        if (clipFactor < maxpct) {
+            // if max clipFactor < maxpct (0.95) adjust per channel factors
+            for (int c = 0; c < 3; ++c) {
+                factor[c] *= (maxpct / clipFactor);
+            }
+        }
+    } else {
+        factor[0] = factor[1] = factor[2] = 1.f;
+    }
+
+    if (settings->verbose) {
+        for (int c = 0; c < 3; ++c) {
+            printf("correction factor[%d] : %f\n", c, static_cast<double>(factor[c]));
+        }
+    }
+
+    float max_f[3];
+    float thresh[3];
+
+    for (int c = 0; c < 3; ++c) {
+        thresh[c] = chmax[c] * threshpct / factor[c];
+        max_f[c] = chmax[c] * maxpct / factor[c];
+    }
+
+    const float whitept = max(max_f[0], max_f[1], max_f[2]);
+    const float clippt  = min(max_f[0], max_f[1], max_f[2]);
+    const float medpt   = max_f[0] + max_f[1] + max_f[2] - whitept - clippt;
+    const float blendpt = blendthresh * clippt;
+
+    float medFactor[3];
+
+    for (int c = 0; c < 3; ++c) {
+        medFactor[c] = max(1.0f, max_f[c] / medpt) / -blendpt;
+    }
+
+    constexpr int blurBorder = 256;
+    const std::vector<ClippedRegion> regions = findClippedRegions(red, green, blue, max_f, width, height, blurBorder);
+
+    if (regions.empty()) { // nothing to reconstruct
+        return;
+    }
+
+    // Distant clipped areas are reconstructed separately, so well exposed parts between them are skipped.
+    // The propagation maps of each area are built from its own box only, so the result differs from a
+    // reconstruction of the whole image when an image has several separate clipped areas.
+    const double progressScale = 1.0 / regions.size();
+
+    for (const auto &region : regions) {
+        reconstructRegion(red, green, blue, blur, region, max_f, thresh, medFactor, whitept, clippt, blendpt, plistener, progress, progressScale);
+    }
 
     if (plistener) {
         plistener->setProgress(1.00);
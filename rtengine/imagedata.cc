@@ -16,6 +16,7 @@
  *  You should have received a copy of the GNU General Public License
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <cstring>
 #include <functional>
 
 #include <strings.h>
@@ -29,6 +30,7 @@
 #include "imagedata.h"
 #include "imagesource.h"
 #include "iptcpairs.h"
+#include "myfile.h"
 #include "procparams.h"
 #include "rt_math.h"
 #include "utils.h"
@@ -78,6 +80,71 @@ const std::string& validateUft8(const std::string& str, const std::string& on_er
     return on_error;
 }
 
+void simplifyMake(std::string& make)
+{
+    // Same dcraw treatment
+    for (const auto& corp : {
+    "Canon",
+    "NIKON",
+    "EPSON",
+    "KODAK",
+    "Kodak",
+    "OLYMPUS",
+    "PENTAX",
+    "RICOH",
+    "MINOLTA",
+    "Minolta",
+    "Konica",
+    "CASIO",
+    "Sinar",
+    "Phase One",
+    "SAMSUNG",
+    "Mamiya",
+    "MOTOROLA",
+    "Leaf",
+    "Panasonic"
+}) {
+        if (make.find(corp) != std::string::npos) { // Simplify company names
+            make = corp;
+            break;
+        }
+    }
+
+    make.erase(make.find_last_not_of(' ') + 1);
+}
+
+void simplifyModel(const std::string& make, std::string& model)
+{
+    if (!model.empty()) {
+        std::string::size_type i = 0;
+
+        if (
+            make.find("KODAK") != std::string::npos
+            && (
+                (i = model.find(" DIGITAL CAMERA")) != std::string::npos
+                || (i = model.find(" Digital Camera")) !=  std::string::npos
+                || (i = model.find("FILE VERSION")) !=  std::string::npos
+            )
+        ) {
+            model.resize(i);
+        }
+
+        model.erase(model.find_last_not_of(' ') + 1);
+
+        if (!strncasecmp(model.c_str(), make.c_str(), make.size())) {
+            if (model.size() >= make.size() && model[make.size()] == ' ') {
+                model.erase(0, make.size() + 1);
+            }
+        }
+
+        if (model.find("Digital Camera ") != std::string::npos) {
+            model.erase(0, 15);
+        }
+    } else {
+        model = "Unknown";
+    }
+}
+
 }
 
 FramesMetaData* FramesMetaData::fromFile(const Glib::ustring& fname, std::unique_ptr<RawMetaDataLocation> rml, bool firstFrameOnly)
@@ -85,6 +152,12 @@ FramesMetaData* FramesMetaData::fromFile(const Glib::ustring& fname, std::unique
     return new FramesData(fname, std::move(rml), firstFrameOnly);
 }
 
+FramesMetaData* FramesMetaData::fromFileQuick(const Glib::ustring& fname)
+{
+    std::unique_ptr<QuickFramesData> data(new QuickFramesData(fname));
+    return data->isValid() ? data.release() : nullptr;
+}
+
 FrameData::FrameData(rtexif::TagDirectory* frameRootDir_, rtexif::TagDirectory* rootDir, rtexif::TagDirectory* firstRootDir) :
     frameRootDir(frameRootDir_),
     iptc(nullptr),
@@ -132,36 +205,7 @@ FrameData::FrameData(rtexif::TagDirectory* frameRootDir_, rtexif::TagDirectory*
 
     if (tag) {
         make = validateUft8(tag->valueToString());
-
-        // Same dcraw treatment
-        for (const auto& corp : {
-        "Canon",
-        "NIKON",
-        "EPSON",
-        "KODAK",
-        "Kodak",
-        "OLYMPUS",
-        "PENTAX",
-        "RICOH",
-        "MINOLTA",
-        "Minolta",
-        "Konica",
-        "CASIO",
-        "Sinar",
-        "Phase One",
-        "SAMSUNG",
-        "Mamiya",
-        "MOTOROLA",
-        "Leaf",
-        "Panasonic"
-    }) {
-            if (make.find(corp) != std::string::npos) { // Simplify company names
-                make = corp;
-                break;
-            }
-        }
-
-        make.erase(make.find_last_not_of(' ') + 1);
+        simplifyMake(make);
     }
 
     tag = newFrameRootDir->findTagUpward("Model");
@@ -170,34 +214,7 @@ FrameData::FrameData(rtexif::TagDirectory* frameRootDir_, rtexif::TagDirectory*
         model = validateUft8(tag->valueToString());
     }
 
-    if (!model.empty()) {
-        std::string::size_type i = 0;
-
-        if (
-            make.find("KODAK") != std::string::npos
-            && (
-                (i = model.find(" DIGITAL CAMERA")) != std::string::npos
-                || (i = model.find(" Digital Camera")) !=  std::string::npos
-                || (i = model.find("FILE VERSION")) !=  std::string::npos
-            )
-        ) {
-            model.resize(i);
-        }
-
-        model.erase(model.find_last_not_of(' ') + 1);
-
-        if (!strncasecmp(model.c_str(), make.c_str(), make.size())) {
-            if (model.size() >= make.size() && model[make.size()] == ' ') {
-                model.erase(0, make.size() + 1);
-            }
-        }
-
-        if (model.find("Digital Camera ") != std::string::npos) {
-            model.erase(0, 15);
-        }
-    } else {
-        model = "Unknown";
-    }
+    simplifyModel(make, model);
 
     if (model == "Unknown") {
         tag = newFrameRootDir->findTag("UniqueCameraModel");
@@ -1457,3 +1474,444 @@ FramesData::~FramesData()
         iptc_data_free(iptc);
     }
 }
+
+namespace
+{
+
+// The IFD0 and the Exif IFD of raw files are in their first few KB, the JPEG embedded in RAF files
+// follows a short header: scanning more than that means the layout is not what the quick scan expects.
+constexpr size_t quickScanLength = 512 * 1024;
+
+// Bounded reader of the tags of a TIFF structure: every offset is checked against the scanned bytes.
+class QuickTiffScanner
+{
+public:
+    struct Entry {
+        unsigned short tag;
+        unsigned short type;
+        unsigned int count;
+        size_t valuePos;
+    };
+
+    QuickTiffScanner(const unsigned char* data, size_t size) :
+        data(data),
+        size(size),
+        base(0),
+        bigEndian(false)
+    {
+    }
+
+    // Finds the TIFF header either at the start of the file, or in the Exif segment of the JPEG embedded in RAF files.
+    // Returns the offset of IFD0, 0 if not found.
+    size_t findIfd0()
+    {
+        if (size >= 88 && !memcmp(data, "FUJIFILM", 8)) {
+            bigEndian = true;
+            return findJpegExif(get4(84));
+        }
+
+        return readTiffHeader(0);
+    }
+
+    // Calls onTag for all the tags of the IFD at the given offset (relative to the TIFF header).
+    template<typename Callback>
+    bool readIfd(size_t offset, Callback onTag) const
+    {
+        const size_t pos = base + offset;
+
+        if (offset == 0 || pos + 2 > size) {
+            return false;
+        }
+
+        const unsigned count = get2(pos);
+
+        if (pos + 2 + 12 * count > size) {
+            return false;
+        }
+
+        for (unsigned i = 0; i < count; ++i) {
+            const size_t entryPos = pos + 2 + 12 * i;
+            Entry entry;
+            entry.tag = get2(entryPos);
+            entry.type = get2(entryPos + 2);
+            entry.count = get4(entryPos + 4);
+            const size_t length = static_cast<size_t>(typeSize(entry.type)) * entry.count;
+            entry.valuePos = length <= 4 ? entryPos + 8 : base + get4(entryPos + 8);
+
+            if (length && entry.valuePos + length <= size) {
+                onTag(entry);
+            }
+        }
+
+        return true;
+    }
+
+    unsigned int getInt(const Entry& entry) const
+    {
+        switch (entry.type) {
+            case 1: // BYTE
+                return data[entry.valuePos];
+
+            case 3: // SHORT
+                return get2(entry.valuePos);
+
+            case 4: // LONG
+                return get4(entry.valuePos);
+
+            default:
+                return 0;
+        }
+    }
+
+    double getDouble(const Entry& entry) const
+    {
+        switch (entry.type) {
+            case 5: { // RATIONAL
+                const double num = get4(entry.valuePos);
+                const double denom = get4(entry.valuePos + 4);
+                return denom == 0. ? 0. : num / denom;
+            }
+
+            case 10: { // SRATIONAL
+                const double num = static_cast<int>(get4(entry.valuePos));
+                const double denom = static_cast<int>(get4(entry.valuePos + 4));
+                return denom == 0. ? 0. : num / denom;
+            }
+
+            default:
+                return getInt(entry);
+        }
+    }
+
+    void getRational(const Entry& entry, int& num, int& denom) const
+    {
+        if (entry.type == 5 || entry.type == 10) {
+            num = get4(entry.valuePos);
+            denom = get4(entry.valuePos + 4);
+        }
+    }
+
+    std::string getString(const Entry& entry) const
+    {
+        const char* const str = reinterpret_cast<const char*>(data + entry.valuePos);
+        return std::string(str, strnlen(str, entry.count));
+    }
+
+private:
+    size_t readTiffHeader(size_t pos)
+    {
+        if (pos + 8 > size) {
+            return 0;
+        }
+
+        if (data[pos] == 'I' && data[pos + 1] == 'I') {
+            bigEndian = false;
+        } else if (data[pos] == 'M' && data[pos + 1] == 'M') {
+            bigEndian = true;
+        } else {
+            return 0;
+        }
+
+        if (get2(pos + 2) != 42) {
+            return 0;
+        }
+
+        base = pos;
+        return get4(pos + 4);
+    }
+
+    size_t findJpegExif(size_t pos)
+    {
+        if (pos + 2 > size || data[pos] != 0xff || data[pos + 1] != 0xd8) {
+            return 0;
+        }
+
+        pos += 2;
+
+        // walk the segments up to the start of the compressed data
+        while (pos + 4 <= size && data[pos] == 0xff && data[pos + 1] != 0xda) {
+            const size_t length = (data[pos + 2] << 8) | data[pos + 3];
+
+            if (data[pos + 1] == 0xe1 && pos + 10 <= size && !memcmp(data + pos + 4, "Exif\0\0", 6)) {
+                return readTiffHeader(pos + 10);
+            }
+
+            pos += 2 + length;
+        }
+
+        return 0;
+    }
+
+    static int typeSize(unsigned short type)
+    {
+        // BYTE ASCII SHORT LONG RATIONAL SBYTE UNDEFINED SSHORT SLONG SRATIONAL FLOAT DOUBLE
+        static const int sizes[] = {0, 1, 1, 2, 4, 8, 1, 1, 2, 4, 8, 4, 8};
+        return type < sizeof(sizes) / sizeof(sizes[0]) ? sizes[type] : 0;
+    }
+
+    unsigned int get2(size_t pos) const
+    {
+        return bigEndian ? (data[pos] << 8) | data[pos + 1] : data[pos] | (data[pos + 1] << 8);
+    }
+
+    unsigned int get4(size_t pos) const
+    {
+        return bigEndian ? (get2(pos) << 16) | get2(pos + 2) : get2(pos) | (get2(pos + 2) << 16);
+    }
+
+    const unsigned char* const data;
+    const size_t size;
+    size_t base;
+    bool bigEndian;
+};
+
+// Same lookup as rtexif::TagDirectory::getXMPTagValue()
+bool getXMPValue(const std::string& xmp, const std::string& name, std::string& value)
+{
+    std::string::size_type pos = 0;
+
+    while ((pos = xmp.find(name, pos)) != std::string::npos) {
+        const std::string::size_type next = pos + name.size();
+
+        if (next < xmp.size() && (xmp[next] == ' ' || xmp[next] == '>' || xmp[next] == '=')) {
+            break;
+        }
+
+        pos = next;
+    }
+
+    if (pos == std::string::npos) {
+        return false;
+    }
+
+    const std::string::size_type posTag = xmp.find('>', pos);
+    const std::string::size_type posAttr = xmp.find('"', pos);
+
+    if (posTag < posAttr) {
+        const std::string::size_type end = xmp.find('<', posTag + 1);
+        value = xmp.substr(posTag + 1, end == std::string::npos ? end : end - posTag - 1);
+        return true;
+    } else if (posAttr < posTag) {
+        const std::string::size_type end = xmp.find('"', posAttr + 1);
+        value = xmp.substr(posAttr + 1, end == std::string::npos ? end : end - posAttr - 1);
+        return true;
+    }
+
+    return false;
+}
+
+}
+
+QuickFramesData::QuickFramesData(const Glib::ustring& fname) :
+    valid(false),
+    time{},
+    timeStamp(-1),
+    iso_speed(0),
+    aperture(0.),
+    focal_len(0.),
+    focal_len35mm(0.),
+    focus_dist(0.f),
+    shutter(0.),
+    expcomp(0.),
+    make("Unknown"),
+    model("Unknown"),
+    orientation("Unknown"),
+    rating(0),
+    lens("Unknown")
+{
+    const std::unique_ptr<IMFILE, void (*)(IMFILE*)> file(gfopen_head(fname.c_str(), quickScanLength), fclose);
+
+    if (!file) {
+        return;
+    }
+
+    QuickTiffScanner scanner(reinterpret_cast<const unsigned char*>(file->data), std::min<size_t>(file->size, quickScanLength));
+
+    bool hasMake = false, hasModel = false, isDng = false;
+    unsigned int orientationValue = 0, exifOffset = 0;
+    std::string xmp;
+
+    const bool hasIfd0 = scanner.readIfd(
+        scanner.findIfd0(),
+        [&](const QuickTiffScanner::Entry& entry)
+        {
+            switch (entry.tag) {
+                case 0x010f: // Make
+                    make = validateUft8(scanner.getString(entry));
+                    hasMake = true;
+                    break;
+
+                case 0x0110: // Model
+                    model = validateUft8(scanner.getString(entry));
+                    hasModel = true;
+                    break;
+
+                case 0x0112: // Orientation
+                    orientationValue = scanner.getInt(entry);
+                    break;
+
+                case 0x02bc: // ApplicationNotes (XMP)
+                    xmp = scanner.getString(entry);
+                    break;
+
+                case 0x4746: // Rating
+                    rating = scanner.getInt(entry);
+                    break;
+
+                case 0x8769: // Exif IFD
+                    exifOffset = scanner.getInt(entry);
+                    break;
+
+                case 0xc612: // DNGVersion
+                    isDng = true;
+                    break;
+            }
+        }
+    );
+
+    if (!hasIfd0 || !hasMake || isDng) {
+        // DNG files may be HDR and carry their lens in DNGLensInfo, leave them to FramesData
+        return;
+    }
+
+    simplifyMake(make);
+
+    if (!hasModel) {
+        model.clear();
+    }
+
+    simplifyModel(make, model);
+
+    // The makernotes of these makers are needed to find the lens, HDR and PixelShift the same way as FramesData
+    for (const auto& maker : {"NIKON", "Canon", "PENTAX", "RICOH", "SONY", "KONICA", "OLYMPUS", "Panasonic"}) {
+        if (!make.compare(0, strlen(maker), maker)) {
+            return;
+        }
+    }
+
+    bool hasExposureTime = false, hasFNumber = false, hasDate = false, hasMakerNote = false, hasLensModel = false;
+    std::string lensMake, lensModel;
+    int num = -3, denom = -3;
+
+    const bool hasExif = scanner.readIfd(
+        exifOffset,
+        [&](const QuickTiffScanner::Entry& entry)
+        {
+            switch (entry.tag) {
+                case 0x829a: // ExposureTime
+                    shutter = scanner.getDouble(entry);
+                    hasExposureTime = true;
+                    break;
+
+                case 0x829d: // FNumber
+                    aperture = scanner.getDouble(entry);
+                    hasFNumber = true;
+                    break;
+
+                case 0x8827: // ISOSpeedRatings
+                    iso_speed = scanner.getDouble(entry);
+                    break;
+
+                case 0x9003: // DateTimeOriginal
+                    if (sscanf(scanner.getString(entry).c_str(), "%d:%d:%d %d:%d:%d", &time.tm_year, &time.tm_mon, &time.tm_mday, &time.tm_hour, &time.tm_min, &time.tm_sec) == 6) {
+                        time.tm_year -= 1900;
+                        time.tm_mon -= 1;
+                        time.tm_isdst = -1;
+                        timeStamp = mktime(&time);
+                        hasDate = true;
+                    }
+
+                    break;
+
+                case 0x9204: // ExposureBiasValue
+                    expcomp = scanner.getDouble(entry);
+                    break;
+
+                case 0x9206: // SubjectDistance
+                    scanner.getRational(entry, num, denom);
+                    break;
+
+                case 0x920a: // FocalLength
+                    focal_len = scanner.getDouble(entry);
+                    break;
+
+                case 0xa405: // FocalLengthIn35mmFilm
+                    focal_len35mm = scanner.getDouble(entry);
+                    break;
+
+                case 0xa433: // LensMake
+                    lensMake = validateUft8(scanner.getString(entry));
+                    break;
+
+                case 0xa434: // LensModel
+                    lensModel = validateUft8(scanner.getString(entry));
+                    hasLensModel = true;
+                    break;
+
+                case 0x927c: // MakerNote, only its presence matters here
+                    hasMakerNote = true;
+                    break;
+            }
+        }
+    );
+
+    // Without these, FramesData falls back to other tags: let it do so
+    if (!hasExif || !hasExposureTime || !hasFNumber || !hasDate) {
+        return;
+    }
+
+    // same lens lookup as FramesData for the makers not listed above
+    if (!make.compare(0, 8, "FUJIFILM")) {
+        if (hasLensModel) {
+            lens = lensModel;
+        }
+    } else if (!hasMakerNote) {
+        if (lensModel.empty()) {
+            // FramesData would use LensInfo
+            return;
+        }
+
+        lens = lensMake.empty() ? lensModel : lensMake + ' ' + lensModel;
+    }
+
+    std::string value;
+
+    if (num == -3 && getXMPValue(xmp, "aux:ApproximateFocusDistance", value)) {
+        sscanf(value.c_str(), "%d/%d", &num, &denom);
+    }
+
+    if (num != -3) {
+        if ((denom == 1 && num >= 10000) || num < 0 || denom < 0) {
+            focus_dist = 10000;    // infinity
+        } else if (denom > 0) {
+            focus_dist = (float)num / denom;
+        }
+    }
+
+    if (getXMPValue(xmp, "xmp:Rating", value)) {
+        rating = rtengine::max(0, rtengine::min(5, atoi(value.c_str())));
+    }
+
+    static const char* const orientations[] = {
+        "Unknown",
+        "Horizontal (normal)",
+        "Mirror horizontal ",
+        "Rotate 180",
+        "Mirror vertical",
+        "Mirror horizontal and rotate 270 CW",
+        "Rotate 90 CW",
+        "Mirror horizontal and rotate 90 CW",
+        "Rotate 270 CW"
+    };
+
+    if (orientationValue < sizeof(orientations) / sizeof(orientations[0])) {
+        orientation = orientations[orientationValue];
+    }
+
+    valid = true;
+}
+
+procparams::IPTCPairs QuickFramesData::getIPTCData(unsigned int frame) const
+{
+    return procparams::IPTCPairs();
+}
@@ -144,5 +144,55 @@ public:
     int getRating (unsigned int frame = 0) const override;
 };
 
+// Basic shooting information read by FramesMetaData::fromFileQuick(), see there
+class QuickFramesData final : public FramesMetaData {
+private:
+    bool valid;
+    tm time;
+    time_t timeStamp;
+    int iso_speed;
+    double aperture;
+    double focal_len, focal_len35mm;
+    float focus_dist;
+    double shutter;
+    double expcomp;
+    std::string make, model;
+    std::string orientation;
+    int rating;
+    std::string lens;
+
+public:
+    explicit QuickFramesData (const Glib::ustring& fname);
+
+    bool isValid () const { return valid; }
+
+    unsigned int getRootCount () const override { return 1; }
+    unsigned int getFrameCount () const override { return 1; }
+    bool getPixelShift () const override { return false; }
+    bool getHDR (unsigned int frame = 0) const override { return false; }
+    std::string getImageType (unsigned int frame) const override { return "STD"; }
+    IIOSampleFormat getSampleFormat (unsigned int frame = 0) const override { return IIOSF_UNKNOWN; }
+    rtexif::TagDirectory* getFrameExifData (unsigned int frame = 0) const override { return nullptr; }
+    rtexif::TagDirectory* getRootExifData (unsigned int root = 0) const override { return nullptr; }
+    rtexif::TagDirectory* getBestExifData (ImageSource *imgSource, procparams::RAWParams *rawParams) const override { return nullptr; }
+    procparams::IPTCPairs getIPTCData (unsigned int frame = 0) const override;
+    bool hasExif (unsigned int frame = 0) const override { return valid; }
+    bool hasIPTC (unsigned int frame = 0) const override { return false; }
+    tm getDateTime (unsigned int frame = 0) const override { return time; }
+    time_t getDateTimeAsTS (unsigned int frame = 0) const override { return timeStamp; }
+    int getISOSpeed (unsigned int frame = 0) const override { return iso_speed; }
+    double getFNumber (unsigned int frame = 0) const override { return aperture; }
+    double getFocalLen (unsigned int frame = 0) const override { return focal_len; }
+    double getFocalLen35mm (unsigned int frame = 0) const override { return focal_len35mm; }
+    float getFocusDist (unsigned int frame = 0) const override { return focus_dist; }
+    double getShutterSpeed (unsigned int frame = 0) const override { return shutter; }
+    double getExpComp (unsigned int frame = 0) const override { return expcomp; }
+    std::string getMake (unsigned int frame = 0) const override { return make; }
+    std::string getModel (unsigned int frame = 0) const override { return model; }
+    std::string getLens (unsigned int frame = 0) const override { return lens; }
+    std::string getOrientation (unsigned int frame = 0) const override { return orientation; }
+    int getRating (unsigned int frame = 0) const override { return rating; }
+};
+
 
 }
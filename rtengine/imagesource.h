@@ -102,6 +102,7 @@ public:
     virtual bool        isRGBSourceModified () const = 0; // tracks whether cached rgb output of demosaic has been modified
 
     virtual void        setBorder (unsigned int border) {}
+    virtual void        setPreviewDemosaic (bool binned) {} // next demosaic only has to be good enough for downscaled previews
     virtual void        setCurrentFrame (unsigned int frameNum) = 0;
     virtual int         getFrameCount () = 0;
     virtual int         getFlatFieldAutoClipValue () = 0;
@@ -78,6 +78,7 @@ ImProcCoordinator::ImProcCoordinator() :
     scale(10),
     highDetailPreprocessComputed(false),
     highDetailRawComputed(false),
+    previewDemosaicComputed(false),
     allocated(false),
     bwAutoR(-9000.f),
     bwAutoG(-9000.f),
@@ -329,16 +330,23 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
                 //    printf("metwb=%s \n", params->wb.method.c_str());
 
     // Check if any detail crops need high detail. If not, take a fast path short cut
-    if (!highDetailNeeded) {
-        for (size_t i = 0; i < crops.size(); i++) {
-            if (crops[i]->get_skip() == 1) {   // skip=1 -> full  resolution
-                highDetailNeeded = true;
-                break;
-            }
+    bool fullResolutionCrop = false;
+
+    for (size_t i = 0; i < crops.size(); i++) {
+        if (crops[i]->get_skip() == 1) {   // skip=1 -> full  resolution
+            fullResolutionCrop = true;
+            break;
         }
     }
 
-    if (((todo & ALL) == ALL) || (todo & M_MONITOR) || panningRelatedChange || (highDetailNeeded && options.prevdemo != PD_Sidecar)) {
+    highDetailNeeded = highDetailNeeded || fullResolutionCrop;
+
+    // At scale >= 2 the preview and the detail windows below 100% use every 2nd or more pixel, so the preview
+    // demosaic is enough whatever method is selected. The selected method runs when full detail is needed.
+    const bool previewDemosaic = scale >= 2 && !(todo & M_HIGHQUAL) && !fullResolutionCrop;
+    const bool previewDemosaicOutdated = previewDemosaicComputed && !previewDemosaic;
+
+    if (((todo & ALL) == ALL) || (todo & M_MONITOR) || panningRelatedChange || (highDetailNeeded && options.prevdemo != PD_Sidecar) || previewDemosaicOutdated) {
         bwAutoR = bwAutoG = bwAutoB = -9000.f;
 
         if (todo == CROP && ipf.needsPCVignetting()) {
@@ -405,6 +413,7 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
 
         if ((todo & M_RAW)
                 || (!highDetailRawComputed && highDetailNeeded)
+                || previewDemosaicOutdated
                 || (params->toneCurve.hrenabled && params->toneCurve.method != "Color" && imgsrc->isRGBSourceModified())
                 || (!params->toneCurve.hrenabled && params->toneCurve.method == "Color" && imgsrc->isRGBSourceModified())) {
 
@@ -428,13 +437,18 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
 
             bool autoContrast = imgsrc->getSensorType() == ST_BAYER ? params->raw.bayersensor.dualDemosaicAutoContrast : params->raw.xtranssensor.dualDemosaicAutoContrast;
             double contrastThreshold = imgsrc->getSensorType() == ST_BAYER ? params->raw.bayersensor.dualDemosaicContrast : params->raw.xtranssensor.dualDemosaicContrast;
+            imgsrc->setPreviewDemosaic(previewDemosaic);
             imgsrc->demosaic(rp, autoContrast, contrastThreshold, params->pdsharpening.enabled);
-
-            if (imgsrc->getSensorType() == ST_BAYER && bayerAutoContrastListener && autoContrast) {
-                bayerAutoContrastListener->autoContrastChanged(contrastThreshold);
-            } else if (imgsrc->getSensorType() == ST_FUJI_XTRANS && xtransAutoContrastListener && autoContrast) {
-
-                xtransAutoContrastListener->autoContrastChanged(contrastThreshold);
+            imgsrc->setPreviewDemosaic(false);
+            previewDemosaicComputed = previewDemosaic;
+
+            // the binned planes of the preview demosaic have no dual demosaic contrast to report
+            if (!previewDemosaicComputed) {
+                if (imgsrc->getSensorType() == ST_BAYER && bayerAutoContrastListener && autoContrast) {
+                    bayerAutoContrastListener->autoContrastChanged(contrastThreshold);
+                } else if (imgsrc->getSensorType() == ST_FUJI_XTRANS && xtransAutoContrastListener && autoContrast) {
+                    xtransAutoContrastListener->autoContrastChanged(contrastThreshold);
+                }
             }
 
             // if a demosaic happened we should also call getimage later, so we need to set the M_INIT flag
@@ -447,18 +461,23 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
             double pdSharpenRadius = params->pdsharpening.deconvradius;
             imgsrc->captureSharpening(params->pdsharpening, sharpMask, pdSharpencontrastThreshold, pdSharpenRadius);
 
-            if (pdSharpenAutoContrastListener && params->pdsharpening.autoContrast) {
-                pdSharpenAutoContrastListener->autoContrastChanged(pdSharpencontrastThreshold);
-            }
+            // the auto values found on the binned planes of the preview demosaic are not the ones of the full demosaic,
+            // so they are used for the preview but not reported to the GUI
+            if (!previewDemosaicComputed) {
+                if (pdSharpenAutoContrastListener && params->pdsharpening.autoContrast) {
+                    pdSharpenAutoContrastListener->autoContrastChanged(pdSharpencontrastThreshold);
+                }
 
-            if (pdSharpenAutoRadiusListener && params->pdsharpening.autoRadius) {
-                pdSharpenAutoRadiusListener->autoRadiusChanged(pdSharpenRadius);
+                if (pdSharpenAutoRadiusListener && params->pdsharpening.autoRadius) {
+                    pdSharpenAutoRadiusListener->autoRadiusChanged(pdSharpenRadius);
+                }
             }
         }
 
 
         if ((todo & M_RAW)
                 || (!highDetailRawComputed && highDetailNeeded)
+                || previewDemosaicOutdated
                 || (params->toneCurve.hrenabled && params->toneCurve.method != "Color" && imgsrc->isRGBSourceModified())
                 || (!params->toneCurve.hrenabled && params->toneCurve.method == "Color" && imgsrc->isRGBSourceModified())) {
             if (highDetailNeeded) {
@@ -1879,7 +1898,7 @@ void ImProcCoordinator::updatePreviewImage(int todo, bool panningRelatedChange)
 
 // process crop, if needed
     for (size_t i = 0; i < crops.size(); i++)
-        if (crops[i]->hasListener() && (panningRelatedChange || (highDetailNeeded && options.prevdemo != PD_Sidecar) || (todo & (M_MONITOR | M_RGBCURVE | M_LUMACURVE)) || crops[i]->get_skip() == 1)) {
+        if (crops[i]->hasListener() && (panningRelatedChange || (highDetailNeeded && options.prevdemo != PD_Sidecar) || previewDemosaicOutdated || (todo & (M_MONITOR | M_RGBCURVE | M_LUMACURVE)) || crops[i]->get_skip() == 1)) {
             crops[i]->update(todo);     // may call ourselves
         }
 
@@ -2719,6 +2738,11 @@ void ImProcCoordinator::endUpdateParams(int changeFlags)
 bool ImProcCoordinator::getHighQualComputed()
 {
     // this function may only be called from detail windows
+    if (previewDemosaicComputed) {
+        // the preview demosaic has to be replaced at 100%
+        return false;
+    }
+
     if (!highQualityComputed) {
         if (options.prevdemo == PD_Sidecar) {
             // we already have high quality preview
@@ -92,6 +92,7 @@ protected:
     int scale;
     bool highDetailPreprocessComputed;
     bool highDetailRawComputed;
+    bool previewDemosaicComputed; // the last demosaic was the preview demosaic
     bool allocated;
 
     void freeAll();
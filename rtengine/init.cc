@@ -17,7 +17,9 @@
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include <fftw3.h>
+#include "../rtgui/options.h"
 #include "../rtgui/profilestorecombobox.h"
+#include "bufferpool.h"
 #include "color.h"
 #include "rtengine.h"
 #include "iccstore.h"
@@ -34,6 +36,8 @@
 #include "../rtgui/threadutils.h"
 #include "rtlensfun.h"
 #include "procparams.h"
+#include "simdkernels.h"
+#include "mytime.h"
 
 namespace rtengine
 {
@@ -45,7 +49,11 @@ MyMutex *fftwMutex = nullptr;
 
 int init (const Settings* s, const Glib::ustring& baseDir, const Glib::ustring& userSettingsDir, bool loadAll)
 {
+    MyTime startTime;
+    startTime.set();
+
     settings = s;
+    setBufferPoolCapacity(static_cast<std::size_t>(options.bufferPoolSize) << 20);
     ProcParams::init();
     PerceptualToneCurve::init();
     RawImageSource::init();
@@ -103,9 +111,23 @@ int init (const Settings* s, const Glib::ustring& baseDir, const Glib::ustring&
 }
 
     Color::init ();
+
+    if (settings->verbose) {
+        const simd::Kernels* kernels = simd::getKernels();
+        printf("Using %s kernels\n", kernels ? kernels->name : "built-in");
+    }
+
     delete lcmsMutex;
     lcmsMutex = new MyMutex;
     fftwMutex = new MyMutex;
+
+    if (settings->verbose) {
+        // lensfun, camera constants, dark frames and flat fields are loaded on first use and not included
+        MyTime stopTime;
+        stopTime.set();
+        printf("Engine initialized in %d ms\n", stopTime.etime(startTime) / 1000);
+    }
+
     return 0;
 }
 
@@ -121,6 +143,10 @@ void cleanup ()
     fftwf_cleanup();
 #endif
 
+    if (settings->verbose) {
+        const BufferPoolStatistics stats = getBufferPoolStatistics();
+        printf("Buffer pool: %zu hits, %zu misses, %zu buffers with %zu MiB kept\n", stats.hits, stats.misses, stats.buffers, stats.bytes >> 20);
+    }
 }
 
 StagedImageProcessor* StagedImageProcessor::create (InitialImage* initialImage)
@@ -18,8 +18,10 @@
  */
 
 #include <memory>
+#include <new>
 
 #include "labimage.h"
+#include "bufferpool.h"
 
 namespace rtengine
 {
@@ -40,7 +42,7 @@ LabImage::LabImage (const LabImage& source, bool multiThread) : W(source.W), H(s
 
 LabImage::~LabImage ()
 {
-    deleteLab();
+    freeLab(true);
 }
 
 void LabImage::CopyFrom(const LabImage *Img, bool multiThread)
@@ -90,7 +92,15 @@ void LabImage::allocLab(size_t w, size_t h)
     a = new float*[h];
     b = new float*[h];
 
-    data = new float [w * h * 3];
+    data = static_cast<float*>(acquireBuffer(w * h * 3 * sizeof(float)));
+
+    if (!data) {
+        delete [] L;
+        delete [] a;
+        delete [] b;
+        throw std::bad_alloc();
+    }
+
     float * index = data;
 
     for (size_t i = 0; i < h; i++) {
@@ -110,12 +120,18 @@ void LabImage::allocLab(size_t w, size_t h)
     }
 }
 
-void LabImage::deleteLab()
+void LabImage::freeLab(bool keep)
 {
     delete [] L;
     delete [] a;
     delete [] b;
-    delete [] data;
+    releaseBuffer(data, static_cast<std::size_t>(W) * H * 3 * sizeof(float), keep);
+}
+
+void LabImage::deleteLab()
+{
+    // the memory is freed to make room for other buffers, keeping it in the pool would defeat that
+    freeLab(false);
 }
 
 void LabImage::reallocLab()
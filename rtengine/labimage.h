@@ -27,6 +27,7 @@ class LabImage final
 {
 private:
     void allocLab(size_t w, size_t h);
+    void freeLab(bool keep);
 
 public:
     int W, H;
@@ -42,6 +43,7 @@ public:
     //Copies image data in Img into this instance.
     void CopyFrom(const LabImage *Img, bool multiThread = true);
     void getPipetteData (float &L, float &a, float &b, int posX, int posY, int squareSize) const;
+    // Frees the buffers to lower the memory use, reallocLab() allocates them again
     void deleteLab();
     void reallocLab();
     void clear(bool multiThread = false);
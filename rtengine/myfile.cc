@@ -17,6 +17,7 @@
  *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "myfile.h"
+#include <algorithm>
 #include <cstdarg>
 #include "rtengine.h"
 // get mmap() sorted out
@@ -68,9 +69,48 @@ int munmap(void *start, size_t length)
 #endif // WIN32
 #endif // MYFILE_MMAP
 
+namespace
+{
+
+// Reads the file, or its first 'limit' bytes if limit >= 0, into a heap buffer
+IMFILE* fopen_read (const char* fname, ssize_t limit = -1)
+{
+
+    FILE* f = g_fopen (fname, "rb");
+
+    if (!f) {
+        return NULL;
+    }
+
+    IMFILE* mf = new IMFILE;
+    memset(mf, 0, sizeof(*mf));
+    mf->fd = -1;
+    fseek (f, 0, SEEK_END);
+    mf->size = ftell (f);
+
+    if (limit >= 0 && limit < mf->size) {
+        mf->size = limit;
+    }
+
+    mf->data = new char [mf->size];
+    fseek (f, 0, SEEK_SET);
+    fread (mf->data, 1, mf->size, f);
+    fclose (f);
+    mf->pos = 0;
+    mf->eof = false;
+
+    return mf;
+}
+
+}
+
 #ifdef MYFILE_MMAP
 
-IMFILE* fopen (const char* fname)
+namespace
+{
+
+// Maps the file. If head >= 0, only the first 'head' bytes are expected to be read and only those are read ahead.
+IMFILE* fopen_mmap (const char* fname, ssize_t head)
 {
     int fd;
 
@@ -106,11 +146,21 @@ IMFILE* fopen (const char* fname)
     void* data = mmap(nullptr, stat_buffer.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
 
     if ( data == MAP_FAILED ) {
-        printf("no mmap %s\n", fname);
+        // e.g. empty files or file systems not supporting mmap, read the file instead
         close(fd);
-        return nullptr;
+        return fopen_read(fname, head);
     }
 
+#if defined(MADV_SEQUENTIAL) && defined(MADV_WILLNEED)
+    if (head < 0) {
+        // the decoders mostly read the raw data front to back: ask for aggressive read-ahead and start it right now
+        madvise(data, stat_buffer.st_size, MADV_SEQUENTIAL);
+        madvise(data, stat_buffer.st_size, MADV_WILLNEED);
+    } else if (head > 0) {
+        madvise(data, std::min<size_t>(head, stat_buffer.st_size), MADV_WILLNEED);
+    }
+#endif
+
     IMFILE* mf = new IMFILE;
 
     memset(mf, 0, sizeof(*mf));
@@ -123,56 +173,37 @@ IMFILE* fopen (const char* fname)
     return mf;
 }
 
+}
+
+IMFILE* fopen (const char* fname)
+{
+    return fopen_mmap(fname, -1);
+}
+
 IMFILE* gfopen (const char* fname)
 {
     return fopen(fname);
 }
+
+IMFILE* gfopen_head (const char* fname, size_t length)
+{
+    return fopen_mmap(fname, length);
+}
 #else
 
 IMFILE* fopen (const char* fname)
 {
-
-    FILE* f = g_fopen (fname, "rb");
-
-    if (!f) {
-        return NULL;
-    }
-
-    IMFILE* mf = new IMFILE;
-    memset(mf, 0, sizeof(*mf));
-    fseek (f, 0, SEEK_END);
-    mf->size = ftell (f);
-    mf->data = new char [mf->size];
-    fseek (f, 0, SEEK_SET);
-    fread (mf->data, 1, mf->size, f);
-    fclose (f);
-    mf->pos = 0;
-    mf->eof = false;
-
-    return mf;
+    return fopen_read(fname);
 }
 
 IMFILE* gfopen (const char* fname)
 {
+    return fopen_read(fname);
+}
 
-    FILE* f = g_fopen (fname, "rb");
-
-    if (!f) {
-        return NULL;
-    }
-
-    IMFILE* mf = new IMFILE;
-    memset(mf, 0, sizeof(*mf));
-    fseek (f, 0, SEEK_END);
-    mf->size = ftell (f);
-    mf->data = new char [mf->size];
-    fseek (f, 0, SEEK_SET);
-    fread (mf->data, 1, mf->size, f);
-    fclose (f);
-    mf->pos = 0;
-    mf->eof = false;
-
-    return mf;
+IMFILE* gfopen_head (const char* fname, size_t length)
+{
+    return fopen_read(fname, length);
 }
 #endif //MYFILE_MMAP
 
@@ -18,6 +18,7 @@
  */
 #pragma once
 
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 
@@ -54,6 +55,9 @@ void imfile_update_progress(IMFILE *f);
 
 IMFILE* fopen (const char* fname);
 IMFILE* gfopen (const char* fname);
+// Opens a file of which only the first 'length' bytes will be read: the mapped build maps the whole file
+// but reads ahead only its head, the other build reads only the head (the file size is truncated to it).
+IMFILE* gfopen_head (const char* fname, size_t length);
 IMFILE* fopen (unsigned* buf, int size);
 void fclose (IMFILE* f);
 inline long ftell (IMFILE* f)
@@ -139,5 +143,102 @@ inline unsigned char* fdata(int offset, IMFILE* f)
     return (unsigned char*)f->data + offset;
 }
 
+/*
+  MSB-first bit reader working directly on the file data, up to 64 bits are kept in the buffer.
+  Decoders use it instead of calling fgetc() for every byte. When zero_after_ff is set, JPEG byte
+  stuffing is handled: 0xFF 0x00 reads as 0xFF and any other marker ends the stream. Past the end
+  of the stream, zero bits are returned.
+  The progress listener is not updated while reading, call imfile_bits_sync() to give the position back.
+ */
+struct IMFILE_bits {
+    const unsigned char* ptr;
+    const unsigned char* end;
+    uint64_t bitbuf;
+    int vbits;
+    int padding; // number of zero bits appended past the end of the stream
+    bool zero_after_ff;
+    bool marker;
+};
+
+inline void imfile_bits_init (IMFILE_bits* b, IMFILE* f, bool zero_after_ff)
+{
+    b->ptr = reinterpret_cast<const unsigned char*>(f->data) + f->pos;
+    b->end = reinterpret_cast<const unsigned char*>(f->data) + f->size;
+    b->bitbuf = 0;
+    b->vbits = 0;
+    b->padding = 0;
+    b->zero_after_ff = zero_after_ff;
+    b->marker = false;
+}
+
+inline void imfile_bits_fill (IMFILE_bits* b)
+{
+    while (b->vbits <= 56) {
+        unsigned c = 0;
+
+        if (LIKELY(b->ptr < b->end && !b->marker)) {
+            c = *b->ptr++;
+
+            if (b->zero_after_ff && c == 0xff) {
+                if (b->ptr < b->end && *b->ptr == 0) {
+                    ++b->ptr;
+                } else {
+                    b->marker = true;
+                    --b->ptr;
+                    c = 0;
+                    b->padding += 8;
+                }
+            }
+        } else {
+            b->padding += 8;
+        }
+
+        b->bitbuf |= static_cast<uint64_t>(c) << (56 - b->vbits);
+        b->vbits += 8;
+    }
+}
+
+// nbits has to be in [1,32]
+inline unsigned imfile_bits_peek (IMFILE_bits* b, int nbits)
+{
+    if (UNLIKELY(b->vbits < nbits)) {
+        imfile_bits_fill(b);
+    }
+
+    return b->bitbuf >> (64 - nbits);
+}
+
+// nbits has to be less or equal than the number of bits peeked before
+inline void imfile_bits_skip (IMFILE_bits* b, int nbits)
+{
+    b->bitbuf <<= nbits;
+    b->vbits -= nbits;
+
+    if (b->padding > b->vbits) {
+        b->padding = b->vbits;
+    }
+}
+
+inline unsigned imfile_bits_get (IMFILE_bits* b, int nbits)
+{
+    const unsigned c = imfile_bits_peek(b, nbits);
+    imfile_bits_skip(b, nbits);
+    return c;
+}
+
+// Sets the file position to the first byte not fully consumed (approximate if stuffed bytes are still buffered)
+inline void imfile_bits_sync (IMFILE_bits* b, IMFILE* f)
+{
+    const ssize_t pos = (b->ptr - reinterpret_cast<const unsigned char*>(f->data)) - (b->vbits - b->padding + 7) / 8;
+
+    if (f->plistener && pos > f->pos) {
+        f->progress_current += pos - f->pos;
+        imfile_update_progress(f);
+    }
+
+    f->pos = pos;
+    f->eof = !b->marker && b->padding > 0;
+}
+
 int fscanf (IMFILE* f, const char* s ...);
 char* fgets (char* s, int n, IMFILE* f);
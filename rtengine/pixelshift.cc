@@ -723,46 +723,19 @@ BENCHFUN
 
 
     if(motionDetection) {
-        // fill channels psRed and psBlue
-        array2D<float> psRed(winw + 32, winh); // increase width to avoid cache conflicts
-        array2D<float> psBlue(winw + 32, winh);
+        // red or blue value at (i, j), taken from the frame which has this colour at (i, j).
+        // Picking the values on the fly saves two full size planes and a pass over the frames
+        const auto nonGreen = [this, &cfarray](int i, int j, bool isBlue, const float brightness[4]) {
+            const unsigned int offset = fc(cfarray, i, j) & 1;
 
-#ifdef _OPENMP
-        #pragma omp parallel for schedule(dynamic,16)
-#endif
-
-        for(int i = winy + 1; i < winh - 1; ++i) {
-            float *nonGreenDest0 = psRed[i];
-            float *nonGreenDest1 = psBlue[i];
-            float ngbright[2][4] = {{redBrightness[0], redBrightness[1], redBrightness[2], redBrightness[3]},
-                                    {blueBrightness[0], blueBrightness[1], blueBrightness[2], blueBrightness[3]}
-                                   };
-            int ng = 0;
-            int j = winx + 1;
-            int c = fc(cfarray, i, j);
-
-            if((c + fc(cfarray, i, j + 1)) == 3) {
-                // row with blue pixels => swap destination pointers for non green pixels
-                std::swap(nonGreenDest0, nonGreenDest1);
-                ng ^= 1;
-            }
-
-            // offset to keep the code short. It changes its value between 0 and 1 for each iteration of the loop
-            unsigned int offset = c & 1;
-
-            for(; j < winw - 1; ++j) {
-                // store the non green values from the 4 frames into 2 temporary planes
-                nonGreenDest0[j] = (*rawDataFrames[(offset << 1) + offset])[i][j + offset] * ngbright[ng][(offset << 1) + offset];
-                nonGreenDest1[j] = (*rawDataFrames[2 - offset])[i + 1][j - offset + 1] * ngbright[ng ^ 1][2 - offset];
-                offset ^= 1; // 0 => 1 or 1 => 0
+            if(((fc(cfarray, i, 0) + fc(cfarray, i, 1)) == 3) == isBlue) {
+                return (*rawDataFrames[(offset << 1) + offset])[i][j + offset] * brightness[(offset << 1) + offset];
+            } else {
+                return (*rawDataFrames[2 - offset])[i + 1][j - offset + 1] * brightness[2 - offset];
             }
-        }
-
-        if(plistener) {
-            plistener->setProgress(0.3);
-        }
+        };
 
-        // now that the temporary planes are filled for easy access we do the motion detection
+        // motion detection
         array2D<float> psMask(winw, winh);
 
         int offsX = 0, offsY = 0;
@@ -811,11 +784,11 @@ BENCHFUN
 
                 if(checkNonGreenCross) {
                     // check red cross
-                    float redTop    = psRed[i - 1][j];
-                    float redLeft   = psRed[i][j - 1];
-                    float redCentre = psRed[i][j];
-                    float redRight  = psRed[i][j + 1];
-                    float redBottom = psRed[i + 1][j];
+                    float redTop    = nonGreen(i - 1, j, false, redBrightness);
+                    float redLeft   = nonGreen(i, j - 1, false, redBrightness);
+                    float redCentre = nonGreen(i, j, false, redBrightness);
+                    float redRight  = nonGreen(i, j + 1, false, redBrightness);
+                    float redBottom = nonGreen(i + 1, j, false, redBrightness);
                     float redDiff   = nonGreenDiffCross(redRight, redLeft, redTop, redBottom, redCentre, clippedRed, stddevFactorRed, eperIsoRed, nRead, prnu);
 
                     if(redDiff > 0.f) {
@@ -824,11 +797,11 @@ BENCHFUN
                     }
 
                     // check blue cross
-                    float blueTop    = psBlue[i - 1][j];
-                    float blueLeft   = psBlue[i][j - 1];
-                    float blueCentre = psBlue[i][j];
-                    float blueRight  = psBlue[i][j + 1];
-                    float blueBottom = psBlue[i + 1][j];
+                    float blueTop    = nonGreen(i - 1, j, true, blueBrightness);
+                    float blueLeft   = nonGreen(i, j - 1, true, blueBrightness);
+                    float blueCentre = nonGreen(i, j, true, blueBrightness);
+                    float blueRight  = nonGreen(i, j + 1, true, blueBrightness);
+                    float blueBottom = nonGreen(i + 1, j, true, blueBrightness);
                     float blueDiff   = nonGreenDiffCross(blueRight, blueLeft, blueTop, blueBottom, blueCentre, clippedBlue, stddevFactorBlue, eperIsoBlue, nRead, prnu);
 
                     if(blueDiff > 0.f) {
@@ -957,13 +930,13 @@ BENCHFUN
 #else
                         const float blend = smoothFactor == 0.f ? 1.f : pow_F(std::max(psMask[i][j] - 1.f, 0.f), smoothFactor);
 #endif
-                        redDest[j + offsX] = intp(blend, showMotion ? 0.f : redDest[j + offsX], psRed[i][j] );
+                        redDest[j + offsX] = intp(blend, showMotion ? 0.f : redDest[j + offsX], nonGreen(i, j, false, redBrightness));
                         greenDest[j + offsX] = intp(blend, showMotion ? 13500.f : greenDest[j + offsX], ((*rawDataFrames[1 - offset])[i - offset + 1][j] * greenBrightness[1 - offset] + (*rawDataFrames[3 - offset])[i + offset][j + 1] * greenBrightness[3 - offset]) * 0.5f);
-                        blueDest[j + offsX] = intp(blend, showMotion ? 0.f : blueDest[j + offsX], psBlue[i][j]);
+                        blueDest[j + offsX] = intp(blend, showMotion ? 0.f : blueDest[j + offsX], nonGreen(i, j, true, blueBrightness));
                     } else {
-                        redDest[j + offsX] = psRed[i][j];
+                        redDest[j + offsX] = nonGreen(i, j, false, redBrightness);
                         greenDest[j + offsX] = ((*rawDataFrames[1 - offset])[i - offset + 1][j] * greenBrightness[1 - offset] + (*rawDataFrames[3 - offset])[i + offset][j + 1] * greenBrightness[3 - offset]) * 0.5f;
-                        blueDest[j + offsX] = psBlue[i][j];
+                        blueDest[j + offsX] = nonGreen(i, j, true, blueBrightness);
                     }
                 }
             }
@@ -19,11 +19,15 @@
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <sstream>
+#include <vector>
 
+#include "bufferpool.h"
 #include "camconst.h"
 #include "color.h"
 #include "curves.h"
 #include "dcp.h"
+#include "demosaiccache.h"
 #include "dfmanager.h"
 #include "ffmanager.h"
 #include "iccmatrices.h"
@@ -38,6 +42,7 @@
 #include "rawimage.h"
 #include "rawimagesource_i.h"
 #include "rawimagesource.h"
+#include "rt_algo.h"
 #include "rt_math.h"
 #include "rtengine.h"
 #include "rtlensfun.h"
@@ -1350,6 +1355,8 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
         printf("Flat Field Correction:%s\n", rif->get_filename().c_str());
     }
 
+    bool scaled = false;
+
     if (numFrames == 4) {
         int bufferNumber = 0;
         for (unsigned int i=0; i<4; ++i) {
@@ -1378,6 +1385,10 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
                 rawData[i][j] = (rawData[i][j] + (*rawDataFrames[1])[i][j]) * 0.5f;
             }
         }
+    } else if (!hasFlatField && (ri->getSensorType() == ST_BAYER || ri->getSensorType() == ST_FUJI_XTRANS || ri->get_colors() == 1)) {
+        // the pixels are scaled in the same pass, saves a pass over the image
+        copyAndScaleOriginalPixels(raw, ri, rid, rawData);
+        scaled = true;
     } else {
         copyOriginalPixels(raw, ri, rid, rif, rawData);
     }
@@ -1424,7 +1435,7 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
         for (int i=0; i<4; ++i) {
             scaleColors(0, 0, W, H, raw, *rawDataFrames[i]);
         }
-    } else {
+    } else if (!scaled) {
         scaleColors(0, 0, W, H, raw, rawData); //+ + raw parameters for black level(raw.blackxx)
     }
 
@@ -1614,12 +1625,98 @@ void RawImageSource::preprocess  (const RAWParams &raw, const LensProfParams &le
 }
 //%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 
+// Key of the demosaic disk cache, empty if the result of the method shouldn't be cached.
+// rawData is hashed instead of the file name and the preprocessing parameters, so that changes of dark frames,
+// flat fields... can't give a stale result.
+std::string RawImageSource::getDemosaicCacheKey(const RAWParams &raw, bool autoContrast) const
+{
+    if (!DemosaicCache::getInstance().isEnabled()) {
+        return {};
+    }
+
+    std::ostringstream key;
+    key << W << ' ' << H << ' ' << ri->getSensorType() << ' ' << ri->get_filters() << ' ' << currFrame << ' ' << autoContrast << ' ';
+
+    // besides the raw data, the demosaicers read the border (AMaZE, X-Trans), the initial gain (AMaZE) and the camera matrices (AHD, EAHD, X-Trans)
+    key << border << ' ' << std::hexfloat << initialGain << ' ';
+    float rgbCam[3][4];
+    ri->getRgbCam(rgbCam);
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            key << rgbCam[i][j] << ' ' << imatrices.rgb_cam[i][j] << ' ';
+        }
+    }
+
+    key.unsetf(std::ios_base::floatfield);
+
+    if (ri->getSensorType() == ST_BAYER) {
+        const auto& method = raw.bayersensor.method;
+
+        // the fast ones aren't worth it, pixelshift depends on the other frames too
+        if (method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::FAST)
+                || method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::MONO)
+                || method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::NONE)
+                || method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::PIXELSHIFT)) {
+            return {};
+        }
+
+        key << method << ' ' << raw.bayersensor.dcb_iterations << ' ' << raw.bayersensor.dcb_enhance << ' ' << raw.bayersensor.lmmse_iterations << ' ' << raw.bayersensor.dualDemosaicContrast;
+    } else if (ri->getSensorType() == ST_FUJI_XTRANS) {
+        const auto& method = raw.xtranssensor.method;
+
+        if (method == RAWParams::XTransSensor::getMethodString(RAWParams::XTransSensor::Method::FAST)
+                || method == RAWParams::XTransSensor::getMethodString(RAWParams::XTransSensor::Method::MONO)
+                || method == RAWParams::XTransSensor::getMethodString(RAWParams::XTransSensor::Method::NONE)) {
+            return {};
+        }
+
+        key << method << ' ' << raw.xtranssensor.dualDemosaicContrast;
+        int xtrans[6][6];
+        ri->getXtransMatrix(xtrans);
+
+        for (int i = 0; i < 6; ++i) {
+            for (int j = 0; j < 6; ++j) {
+                key << ' ' << xtrans[i][j];
+            }
+        }
+    } else {
+        return {};
+    }
+
+    key << ' ' << std::hex << hashPlane(rawData, rawData.getWidth(), H);
+    return key.str();
+}
+
 void RawImageSource::demosaic(const RAWParams &raw, bool autoContrast, double &contrastThreshold, bool cache)
 {
     MyTime t1, t2;
     t1.set();
 
-    if (ri->getSensorType() == ST_BAYER) {
+    // the preview demosaic replaces every method but the ones which show the raw data
+    const bool binned = previewDemosaic
+                        && ((ri->getSensorType() == ST_BAYER
+                             && raw.bayersensor.method != RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::NONE)
+                             && raw.bayersensor.method != RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::MONO))
+                            || (ri->getSensorType() == ST_FUJI_XTRANS
+                                && raw.xtranssensor.method != RAWParams::XTransSensor::getMethodString(RAWParams::XTransSensor::Method::NONE)
+                                && raw.xtranssensor.method != RAWParams::XTransSensor::getMethodString(RAWParams::XTransSensor::Method::MONO)));
+    // the binned planes must not be stored under the key of the selected method
+    const std::string diskCacheKey = binned ? std::string() : getDemosaicCacheKey(raw, autoContrast);
+    double cachedContrastThreshold = contrastThreshold;
+    const bool fromDiskCache = !diskCacheKey.empty() && DemosaicCache::getInstance().load(diskCacheKey, red, green, blue, cachedContrastThreshold);
+
+    if (fromDiskCache) {
+        if (autoContrast) {
+            contrastThreshold = cachedContrastThreshold;
+        }
+
+        if (settings->verbose) {
+            printf("Demosaiced data read from disk cache\n");
+        }
+    } else if (binned) {
+        binned_demosaic(rawData, red, green, blue);
+    } else if (ri->getSensorType() == ST_BAYER) {
         if (raw.bayersensor.method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::HPHD)) {
             hphd_demosaic ();
         } else if (raw.bayersensor.method == RAWParams::BayerSensor::getMethodString(RAWParams::BayerSensor::Method::VNG4)) {
@@ -1683,6 +1780,10 @@ void RawImageSource::demosaic(const RAWParams &raw, bool autoContrast, double &c
         nodemosaic(true);
     }
 
+    if (!diskCacheKey.empty() && !fromDiskCache) {
+        DemosaicCache::getInstance().store(diskCacheKey, red, green, blue, contrastThreshold);
+    }
+
     t2.set();
 
 
@@ -1733,9 +1834,9 @@ void RawImageSource::demosaic(const RAWParams &raw, bool autoContrast, double &c
     }
     if (settings->verbose) {
         if (getSensorType() == ST_BAYER) {
-            printf("Demosaicing Bayer data: %s - %d usec\n", raw.bayersensor.method.c_str(), t2.etime(t1));
+            printf("Demosaicing Bayer data: %s - %d usec\n", binned ? "preview" : raw.bayersensor.method.c_str(), t2.etime(t1));
         } else if (getSensorType() == ST_FUJI_XTRANS) {
-            printf("Demosaicing X-Trans data: %s - %d usec\n", raw.xtranssensor.method.c_str(), t2.etime(t1));
+            printf("Demosaicing X-Trans data: %s - %d usec\n", binned ? "preview" : raw.xtranssensor.method.c_str(), t2.etime(t1));
         }
     }
 }
@@ -2402,32 +2503,17 @@ void RawImageSource::flush()
         rawDataBuffer[i] = nullptr;
     }
 
-    if (rawData) {
-        rawData(0, 0);
-    }
-    if (green) {
-        green(0, 0);
-    }
-
-    if (red) {
-        red(0, 0);
-    }
+    // resizing to 0x0 would keep the capacity of the buffers
+    rawData.free();
+    green.free();
+    red.free();
+    blue.free();
+    greenloc.free();
+    redloc.free();
+    blueloc.free();
 
-    if (blue) {
-        blue(0, 0);
-    }
-
-    if (greenloc) {
-        greenloc(0, 0);
-    }
-
-    if (redloc) {
-        redloc(0, 0);
-    }
-
-    if (blueloc) {
-        blueloc(0, 0);
-    }
+    // the buffers are flushed to lower the memory use, so they must not stay in the pool
+    trimBufferPool();
 }
 
 void RawImageSource::HLRecovery_Global(const ToneCurveParams &hrp)
@@ -2548,10 +2634,9 @@ void RawImageSource::copyOriginalPixels(const RAWParams &raw, RawImage *src, Raw
     }
 }
 
-// Scale original pixels into the range 0 65535 using black offsets and multipliers
-void RawImageSource::scaleColors(int winx, int winy, int winw, int winh, const RAWParams &raw, array2D<float> &rawData)
+// Compute the black offsets, white levels and multipliers used to scale the original pixels
+void RawImageSource::updateScaleCoefficients(const RAWParams &raw)
 {
-    chmax[0] = chmax[1] = chmax[2] = chmax[3] = 0; //channel maxima
     float black_lev[4] = {0.f};//black level
 
     //adjust black level  (eg Canon)
@@ -2589,6 +2674,122 @@ void RawImageSource::scaleColors(int winx, int winy, int winw, int winh, const R
     for (int i = 0; i < 4 ; i++) {
         clmax[i] = (c_white[i] - cblacksom[i]) * scale_mul[i];    // raw clip level
     }
+}
+
+/* Same as copyOriginalPixels() followed by scaleColors() on the whole image, in one pass over the image.
+ * Only for single colour per pixel sensors and without flat field, which has to be applied between both.
+ */
+void RawImageSource::copyAndScaleOriginalPixels(const RAWParams &raw, RawImage *src, RawImage *riDark, array2D<float> &rawData)
+{
+    const auto tmpfilters = ri->get_filters();
+    ri->set_filters(ri->prefilters); // we need 4 blacks for bayer processing
+    float black[4];
+    ri->get_colorsCoeff(nullptr, nullptr, black, false);
+    ri->set_filters(tmpfilters);
+
+    updateScaleCoefficients(raw);
+
+    if (!rawData) {
+        rawData(W, H);
+    }
+
+    const bool subtractDark = riDark && W == riDark->get_width() && H == riDark->get_height();
+    const bool isBayer = ri->getSensorType() == ST_BAYER;
+    const bool isMono = !isBayer && ri->get_colors() == 1;
+
+    chmax[0] = chmax[1] = chmax[2] = chmax[3] = 0; //channel maxima
+
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
+    {
+        float tmpchmax[3] = {0.f, 0.f, 0.f};
+
+#ifdef _OPENMP
+        #pragma omp for nowait
+#endif
+
+        for (int row = 0; row < H; ++row) {
+            const float* const srcRow = src->data[row];
+            const float* const darkRow = subtractDark ? riDark->data[row] : nullptr;
+            float* const dstRow = rawData[row];
+
+            // offsets of the dark frame subtraction, the black levels are the same for all colours of x-trans and mono sensors
+            float darkBlack[2];
+
+            for (int i = 0; i < 2; ++i) {
+                const int c = FC(row, i);
+                darkBlack[i] = black[(c == 1 && !(row & 1)) ? 3 : c];
+            }
+
+            if (isBayer) {
+                int colour[2];
+                float cblack[2];
+                float mul[2];
+
+                for (int i = 0; i < 2; ++i) {
+                    colour[i] = FC(row, i);
+                    const int c4 = (colour[i] == 1 && !(row & 1)) ? 3 : colour[i];
+                    cblack[i] = cblacksom[c4];
+                    mul[i] = scale_mul[c4];
+                }
+
+                float rowmax[2] = {0.f, 0.f};
+                int col = 0;
+
+                for (; col < W - 1; col += 2) {
+                    for (int i = 0; i < 2; ++i) {
+                        const float val = darkRow ? max(srcRow[col + i] + darkBlack[i] - darkRow[col + i], 0.f) : srcRow[col + i];
+                        dstRow[col + i] = max(0.f, val - cblack[i]) * mul[i];
+                        rowmax[i] = max(rowmax[i], dstRow[col + i]);
+                    }
+                }
+
+                if (col < W) {
+                    const float val = darkRow ? max(srcRow[col] + darkBlack[0] - darkRow[col], 0.f) : srcRow[col];
+                    dstRow[col] = max(0.f, val - cblack[0]) * mul[0];
+                    rowmax[0] = max(rowmax[0], dstRow[col]);
+                }
+
+                tmpchmax[colour[0]] = max(tmpchmax[colour[0]], rowmax[0]);
+                tmpchmax[colour[1]] = max(tmpchmax[colour[1]], rowmax[1]);
+            } else if (isMono) {
+                for (int col = 0; col < W; ++col) {
+                    const float val = darkRow ? max(srcRow[col] + black[0] - darkRow[col], 0.f) : srcRow[col];
+                    dstRow[col] = max(0.f, val - cblacksom[0]) * scale_mul[0];
+                    tmpchmax[0] = max(tmpchmax[0], dstRow[col]);
+                }
+            } else {
+                for (int col = 0; col < W; ++col) {
+                    const int c = ri->XTRANSFC(row, col);
+                    const float val = darkRow ? max(srcRow[col] + darkBlack[col & 1] - darkRow[col], 0.f) : srcRow[col];
+                    dstRow[col] = max(0.f, val - cblacksom[c]) * scale_mul[c];
+                    tmpchmax[c] = max(tmpchmax[c], dstRow[col]);
+                }
+            }
+        }
+
+#ifdef _OPENMP
+        #pragma omp critical
+#endif
+        {
+            chmax[0] = max(tmpchmax[0], chmax[0]);
+            chmax[1] = max(tmpchmax[1], chmax[1]);
+            chmax[2] = max(tmpchmax[2], chmax[2]);
+        }
+    }
+
+    if (isMono) {
+        chmax[1] = chmax[2] = chmax[3] = chmax[0];
+    }
+}
+
+// Scale original pixels into the range 0 65535 using black offsets and multipliers
+void RawImageSource::scaleColors(int winx, int winy, int winw, int winh, const RAWParams &raw, array2D<float> &rawData)
+{
+    chmax[0] = chmax[1] = chmax[2] = chmax[3] = 0; //channel maxima
+
+    updateScaleCoefficients(raw);
 
     // this seems strange, but it works
 
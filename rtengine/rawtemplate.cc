@@ -0,0 +1,335 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <glibmm/checksum.h>
+#include <glibmm/fileutils.h>
+#include <glibmm/miscutils.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "rawtemplate.h"
+#include "rawimage.h"
+#include "settings.h"
+#include "utils.h"
+#include "../rtgui/options.h"
+#include "../rtgui/threadutils.h"
+
+namespace rtengine
+{
+
+namespace
+{
+
+// the decoders need about 12 bytes per pixel while a frame is loaded, don't load too many of them at once
+constexpr int maxParallelFrames = 4;
+
+// Bump the version in the magic when the computation of the templates changes
+constexpr char cacheMagic[8] = {'R', 'T', 'T', 'P', 'L', '0', '0', '2'};
+
+MyMutex pruneMutex;
+
+// The file starts with the magic, the height, the row size and the number of frames, followed by the length and
+// the text of the build id padded to 16 bytes. The decoders change between versions, so each build gets its own files.
+std::size_t getPaddedSize(std::size_t size)
+{
+    return (size + 15) / 16 * 16;
+}
+
+Glib::ustring getCacheDir()
+{
+    return Glib::build_filename(options.cacheBaseDir, "templates");
+}
+
+// Name of the cache file of the set of files, empty if one of them can't be accessed
+Glib::ustring getCacheFileName(const std::vector<Glib::ustring>& names)
+{
+    if (options.templateCacheSize <= 0 || options.cacheBaseDir.empty()) {
+        return {};
+    }
+
+    std::ostringstream identifier;
+    identifier << getBuildId() << '\n';
+
+    for (const auto& name : names) {
+        GStatBuf stat;
+
+        if (g_stat(name.c_str(), &stat) != 0) {
+            return {};
+        }
+
+        identifier << name << '|' << stat.st_size << '|' << stat.st_mtime << '\n';
+    }
+
+    const std::string md5 = Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_MD5, identifier.str());
+    return Glib::build_filename(getCacheDir(), md5 + ".rtt");
+}
+
+bool readCache(const Glib::ustring& fileName, RawImage* ri, int H, int rSize, int nNames)
+{
+    FILE* const f = g_fopen(fileName.c_str(), "rb");
+
+    if (!f) {
+        return false;
+    }
+
+    char magic[sizeof(cacheMagic)];
+    std::int32_t header[3]; // height, row size, number of frames
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1 && !memcmp(magic, cacheMagic, sizeof(magic))
+              && fread(header, sizeof(header), 1, f) == 1 && header[0] == H && header[1] == rSize
+              && header[2] >= 1 && header[2] <= nNames;
+
+    if (ok) {
+        const std::string& buildId = getBuildId();
+        std::int32_t idHeader[4];
+        std::vector<char> id(getPaddedSize(buildId.size()));
+        ok = fread(idHeader, sizeof(idHeader), 1, f) == 1 && idHeader[0] == static_cast<std::int32_t>(buildId.size())
+             && fread(id.data(), id.size(), 1, f) == 1 && !memcmp(id.data(), buildId.data(), buildId.size());
+    }
+
+    for (int row = 0; ok && row < H; ++row) {
+        ok = fread(ri->data[row], sizeof(float), rSize, f) == static_cast<size_t>(rSize);
+    }
+
+    fclose(f);
+
+    if (ok) {
+        // the modification time is used to find the least recently used files
+        g_utime(fileName.c_str(), nullptr);
+
+        if (settings->verbose) {
+            printf("Template of %d frames read from %s\n", header[2], fileName.c_str());
+        }
+    } else if (settings->verbose) {
+        std::cerr << "Invalid template cache file " << fileName << std::endl;
+    }
+
+    return ok;
+}
+
+// Removes the least recently used files until the folder fits into options.templateCacheSize
+void pruneCache()
+{
+    MyMutex::MyLock lock(pruneMutex);
+
+    struct Entry {
+        std::string name;
+        std::uint64_t size;
+        std::int64_t time;
+    };
+
+    const Glib::ustring dir = getCacheDir();
+    std::vector<Entry> entries;
+    std::uint64_t totalSize = 0;
+
+    try {
+        for (const auto& name : Glib::Dir(dir)) {
+            GStatBuf stat;
+            const std::string path = Glib::build_filename(dir, name);
+
+            if (g_stat(path.c_str(), &stat) == 0) {
+                entries.push_back({path, static_cast<std::uint64_t>(stat.st_size), static_cast<std::int64_t>(stat.st_mtime)});
+                totalSize += stat.st_size;
+            }
+        }
+    } catch (Glib::Exception&) {
+        return;
+    }
+
+    const std::uint64_t maxSize = static_cast<std::uint64_t>(options.templateCacheSize) << 20;
+
+    if (totalSize <= maxSize) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.time < b.time;
+    });
+
+    // the newest file is kept even if it's bigger than the limit on its own, it has just been written
+    for (size_t i = 0; i + 1 < entries.size() && totalSize > maxSize; ++i) {
+        if (g_remove(entries[i].name.c_str()) == 0) {
+            totalSize -= entries[i].size;
+        }
+    }
+}
+
+void writeCache(const Glib::ustring& fileName, const RawImage* ri, int H, int rSize, int nFiles)
+{
+    if (g_mkdir_with_parents(Glib::path_get_dirname(fileName).c_str(), 0777) != 0) {
+        return;
+    }
+
+    // write to a temporary file first, other instances may be reading the cache
+    const Glib::ustring tmpName = fileName + ".tmp" + std::to_string(g_random_int());
+    FILE* const f = g_fopen(tmpName.c_str(), "wb");
+
+    if (!f) {
+        return;
+    }
+
+    const std::int32_t header[3] = {H, rSize, nFiles};
+    const std::string& buildId = getBuildId();
+    const std::int32_t idHeader[4] = {static_cast<std::int32_t>(buildId.size()), 0, 0, 0};
+    const std::string paddedId = buildId + std::string(getPaddedSize(buildId.size()) - buildId.size(), '\0');
+    bool ok = fwrite(cacheMagic, sizeof(cacheMagic), 1, f) == 1 && fwrite(header, sizeof(header), 1, f) == 1
+              && fwrite(idHeader, sizeof(idHeader), 1, f) == 1 && fwrite(paddedId.data(), paddedId.size(), 1, f) == 1;
+
+    for (int row = 0; ok && row < H; ++row) {
+        ok = fwrite(ri->data[row], sizeof(float), rSize, f) == static_cast<size_t>(rSize);
+    }
+
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || g_rename(tmpName.c_str(), fileName.c_str()) != 0) {
+        g_remove(tmpName.c_str());
+
+        if (settings->verbose) {
+            std::cerr << "Failed to write template cache file " << fileName << std::endl;
+        }
+
+        return;
+    }
+
+    pruneCache();
+}
+
+}
+
+RawImage* loadRawTemplate(const std::list<Glib::ustring>& pathNames)
+{
+    typedef unsigned int acc_t;
+
+    if (pathNames.empty()) {
+        return nullptr;
+    }
+
+    const std::vector<Glib::ustring> names(pathNames.begin(), pathNames.end());
+    RawImage* ri = new RawImage(names[0]); // First file used also for extra pixels information (width, height, shutter, filters etc.. )
+
+    if (ri->loadRaw(true)) {
+        delete ri;
+        return nullptr;
+    }
+
+    ri->compress_image(0);
+
+    const int H = ri->get_height();
+    const int W = ri->get_width();
+    const eSensorType sensorType = ri->getSensorType();
+    const int rSize = W * ((sensorType == ST_BAYER || sensorType == ST_FUJI_XTRANS || ri->get_colors() == 1) ? 1 : 3);
+
+    if (names.size() == 1) {
+        return ri;
+    }
+
+    const Glib::ustring cacheFile = getCacheFileName(names);
+
+    if (!cacheFile.empty() && readCache(cacheFile, ri, H, rSize, static_cast<int>(names.size()))) {
+        return ri;
+    }
+
+    // all frames are summed up in one buffer, the rows of ri->data may not be contiguous
+    std::vector<acc_t> acc(static_cast<size_t>(H) * rSize);
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+
+    for (int row = 0; row < H; ++row) {
+        const float* const src = ri->data[row];
+        acc_t* const dst = acc.data() + static_cast<size_t>(row) * rSize;
+
+        for (int col = 0; col < rSize; ++col) {
+            dst[col] = src[col];
+        }
+    }
+
+    int nFiles = 1; // First file data already loaded
+
+#ifdef _OPENMP
+    // nested parallelism is off, each frame is decoded by one thread
+    #pragma omp parallel for schedule(dynamic) num_threads(std::max(1, std::min({static_cast<int>(names.size()) - 1, omp_get_max_threads(), maxParallelFrames})))
+#endif
+
+    for (size_t i = 1; i < names.size(); ++i) {
+        RawImage temp(names[i]);
+
+        if (temp.loadRaw(true)) {
+            continue;
+        }
+
+        temp.compress_image(0);     //\ TODO would be better working on original, because is temporary
+
+        if (temp.get_height() != H || temp.get_width() != W || temp.getSensorType() != sensorType || temp.get_colors() != ri->get_colors()) {
+            if (settings->verbose) {
+                std::cerr << names[i] << " doesn't match " << names[0] << ", not used for the template" << std::endl;
+            }
+
+            continue;
+        }
+
+#ifdef _OPENMP
+        #pragma omp critical(rawTemplateAccumulate)
+#endif
+        {
+            // the raw values are integers, the conversion to int lets the compiler vectorize the loop
+            for (int row = 0; row < H; ++row) {
+                const float* const src = temp.data[row];
+                acc_t* const dst = acc.data() + static_cast<size_t>(row) * rSize;
+
+                for (int col = 0; col < rSize; ++col) {
+                    dst[col] += static_cast<int>(src[col]);
+                }
+            }
+
+            ++nFiles;
+        }
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+
+    for (int row = 0; row < H; ++row) {
+        const acc_t* const src = acc.data() + static_cast<size_t>(row) * rSize;
+        float* const dst = ri->data[row];
+
+        for (int col = 0; col < rSize; ++col) {
+            dst[col] = src[col] / nFiles;
+        }
+    }
+
+    if (!cacheFile.empty()) {
+        writeCache(cacheFile, ri, H, rSize, nFiles);
+    }
+
+    return ri;
+}
+
+}
@@ -0,0 +1,37 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <list>
+
+#include <glibmm/ustring.h>
+
+namespace rtengine
+{
+
+class RawImage;
+
+/*
+  Loads the raw files of a dark frame or flat field template and averages their pixels. The returned image gets all
+  other information (size, filters, black levels...) from the first file, files of another size are skipped.
+  The files are decoded in parallel. The averaged pixels are cached in the "templates" folder of the cache, keyed by
+  the names, sizes and modification times of the files, so that later sessions only have to decode the first file.
+  Returns nullptr if the first file can't be loaded.
+*/
+RawImage* loadRawTemplate(const std::list<Glib::ustring>& pathNames);
+
+}
@@ -22,6 +22,8 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <vector>
 #ifdef _OPENMP
 #include <omp.h>
@@ -149,6 +151,78 @@ float calcContrastThreshold(const float* const * luminance, int tileY, int tileX
 
     return (c + 1) / 100.f;
 }
+
+// blend factors of row 2 <= i < W - 2 of the row luminance[0], luminance[-2] to luminance[2] must be valid
+void calcBlendFactorRow(const float* const * luminance, float *blend, const float *clipMask, int W, float contrastThreshold) {
+    constexpr float scale = 0.0625f / 327.68f;
+    int i = 2;
+#ifdef __SSE2__
+    const vfloat contrastThresholdv = F2V(contrastThreshold);
+    const vfloat scalev = F2V(scale);
+    if (clipMask) {
+        for(; i < W - 5; i += 4) {
+            vfloat contrastv = vsqrtf(SQRV(LVFU(luminance[0][i+1]) - LVFU(luminance[0][i-1])) + SQRV(LVFU(luminance[1][i]) - LVFU(luminance[-1][i])) +
+                                      SQRV(LVFU(luminance[0][i+2]) - LVFU(luminance[0][i-2])) + SQRV(LVFU(luminance[2][i]) - LVFU(luminance[-2][i]))) * scalev;
+
+            STVFU(blend[i], LVFU(clipMask[i]) * calcBlendFactor(contrastv, contrastThresholdv));
+        }
+    } else {
+        for(; i < W - 5; i += 4) {
+            vfloat contrastv = vsqrtf(SQRV(LVFU(luminance[0][i+1]) - LVFU(luminance[0][i-1])) + SQRV(LVFU(luminance[1][i]) - LVFU(luminance[-1][i])) +
+                                      SQRV(LVFU(luminance[0][i+2]) - LVFU(luminance[0][i-2])) + SQRV(LVFU(luminance[2][i]) - LVFU(luminance[-2][i]))) * scalev;
+
+            STVFU(blend[i], calcBlendFactor(contrastv, contrastThresholdv));
+        }
+    }
+#endif
+    for(; i < W - 2; ++i) {
+
+        float contrast = sqrtf(rtengine::SQR(luminance[0][i+1] - luminance[0][i-1]) + rtengine::SQR(luminance[1][i] - luminance[-1][i]) + 
+                               rtengine::SQR(luminance[0][i+2] - luminance[0][i-2]) + rtengine::SQR(luminance[2][i] - luminance[-2][i])) * scale;
+
+        blend[i] = (clipMask ? clipMask[i] : 1.f) * calcBlendFactor(contrast, contrastThreshold);
+    }
+}
+
+// fills the 2 pixel wide borders of the blend mask and blurs it, must be called from inside a parallel region
+void smoothBlendMask(float **blend, int W, int H) {
+#ifdef _OPENMP
+    #pragma omp single
+#endif
+    {
+        // upper border
+        for(int j = 0; j < 2; ++j) {
+            for(int i = 2; i < W - 2; ++i) {
+                blend[j][i] = blend[2][i];
+            }
+        }
+        // lower border
+        for(int j = H - 2; j < H; ++j) {
+            for(int i = 2; i < W - 2; ++i) {
+                blend[j][i] = blend[H-3][i];
+            }
+        }
+        for(int j = 0; j < H; ++j) {
+            // left border
+            blend[j][0] = blend[j][1] = blend[j][2];
+            // right border
+            blend[j][W - 2] = blend[j][W - 1] = blend[j][W - 3];
+        }
+    }
+
+#ifdef __SSE2__
+    // flush denormals to zero for gaussian blur to avoid performance penalty if there are a lot of zero values in the mask
+    const auto oldMode = _MM_GET_FLUSH_ZERO_MODE();
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+#endif
+
+    // blur blend mask to smooth transitions
+    gaussianBlur(blend, blend, W, H, 2.0);
+
+#ifdef __SSE2__
+    _MM_SET_FLUSH_ZERO_MODE(oldMode);
+#endif
+}
 }
 
 namespace rtengine
@@ -290,107 +364,234 @@ void findMinMaxPercentile(const float* data, size_t size, float minPrct, float&
     maxOut = rtengine::LIM(maxOut, minVal, maxVal);
 }
 
-void buildBlendMask(const float* const * luminance, float **blend, int W, int H, float &contrastThreshold, bool autoContrast, float ** clipMask) {
+float calcAutoContrastThreshold(const float* const * luminance, int W, int H) {
 
-    if (autoContrast) {
-        constexpr float minLuminance = 2000.f;
-        constexpr float maxLuminance = 20000.f;
-        constexpr float minTileVariance = 0.5f;
-        for (int pass = 0; pass < 2; ++pass) {
-            const int tilesize = 80 / (pass + 1);
-            const int skip = pass == 0 ? tilesize : tilesize / 4;
-            const int numTilesW = W / skip - 3 * pass;
-            const int numTilesH = H / skip - 3 * pass;
-            std::vector<std::vector<float>> variances(numTilesH, std::vector<float>(numTilesW));
+    constexpr float minLuminance = 2000.f;
+    constexpr float maxLuminance = 20000.f;
+    constexpr float minTileVariance = 0.5f;
+    for (int pass = 0; pass < 2; ++pass) {
+        const int tilesize = 80 / (pass + 1);
+        const int skip = pass == 0 ? tilesize : tilesize / 4;
+        const int numTilesW = W / skip - 3 * pass;
+        const int numTilesH = H / skip - 3 * pass;
+        std::vector<std::vector<float>> variances(numTilesH, std::vector<float>(numTilesW));
 
 #ifdef _OPENMP
-            #pragma omp parallel for schedule(dynamic)
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for (int i = 0; i < numTilesH; ++i) {
+            const int tileY = i * skip;
+            for (int j = 0; j < numTilesW; ++j) {
+                const int tileX = j * skip;
+                const float avg = tileAverage(luminance, tileY, tileX, tilesize);
+                if (avg < minLuminance || avg > maxLuminance) {
+                    // too dark or too bright => skip the tile
+                    variances[i][j] = RT_INFINITY_F;
+                    continue;
+                } else {
+                    variances[i][j] = tileVariance(luminance, tileY, tileX, tilesize, avg);
+                    // exclude tiles with a variance less than minTileVariance
+                    variances[i][j] = variances[i][j] < minTileVariance ? RT_INFINITY_F : variances[i][j];
+                }
+            }
+        }
+
+        float minvar = RT_INFINITY_F;
+        int minI = 0, minJ = 0;
+        for (int i = 0; i < numTilesH; ++i) {
+            for (int j = 0; j < numTilesW; ++j) {
+                if (variances[i][j] < minvar) {
+                    minvar = variances[i][j];
+                    minI = i;
+                    minJ = j;
+                }
+            }
+        }
+
+        if (minvar <= 1.f || pass == 1) {
+            const int minY = skip * minI;
+            const int minX = skip * minJ;
+            if (pass == 0) {
+                // a variance <= 1 means we already found a flat region and can skip second pass
+                return calcContrastThreshold(luminance, minY, minX, tilesize);
+            } else {
+                // in second pass we allow a variance of 8
+                // we additionally scan the tiles +-skip pixels around the best tile from pass 2
+                // Means we scan (2 * skip + 1)^2 tiles in this step to get a better hit rate
+                // fortunately the scan is quite fast, so we use only one core and don't parallelize
+                const int topLeftYStart = std::max(minY - skip, 0);
+                const int topLeftXStart = std::max(minX - skip, 0);
+                const int topLeftYEnd = std::min(minY + skip, H - tilesize);
+                const int topLeftXEnd = std::min(minX + skip, W - tilesize);
+                const int numTilesH = topLeftYEnd - topLeftYStart + 1;
+                const int numTilesW = topLeftXEnd - topLeftXStart + 1;
+
+                std::vector<std::vector<float>> variances(numTilesH, std::vector<float>(numTilesW));
+                for (int i = 0; i < numTilesH; ++i) {
+                    const int tileY = topLeftYStart + i;
+                    for (int j = 0; j < numTilesW; ++j) {
+                        const int tileX = topLeftXStart + j;
+                        const float avg = tileAverage(luminance, tileY, tileX, tilesize);
+
+                        if (avg < minLuminance || avg > maxLuminance) {
+                            // too dark or too bright => skip the tile
+                            variances[i][j] = RT_INFINITY_F;
+                            continue;
+                        } else {
+                            variances[i][j] = tileVariance(luminance, tileY, tileX, tilesize, avg);
+                        // exclude tiles with a variance less than minTileVariance
+                        variances[i][j] = variances[i][j] < minTileVariance ? RT_INFINITY_F : variances[i][j];
+                        }
+                    }
+                }
+
+                float minvar = RT_INFINITY_F;
+                int minI = 0, minJ = 0;
+                for (int i = 0; i < numTilesH; ++i) {
+                    for (int j = 0; j < numTilesW; ++j) {
+                        if (variances[i][j] < minvar) {
+                            minvar = variances[i][j];
+                            minI = i;
+                            minJ = j;
+                        }
+                    }
+                }
+
+                return minvar <= 8.f ? calcContrastThreshold(luminance, topLeftYStart + minI, topLeftXStart + minJ, tilesize) : 0.f;
+            }
+        }
+    }
+
+    return 0.f;
+}
+
+float calcAutoContrastThresholdTiled(const std::function<void(int row, int col, int width, float* luminance)>& getLuminance, int W, int H) {
+
+    constexpr float minLuminance = 2000.f;
+    constexpr float maxLuminance = 20000.f;
+    constexpr float minTileVariance = 0.5f;
+
+    // luminance of a strip of whole rows, the tiles of the strip are addressed relative to its top row.
+    // Whole rows are read, so the luminance is computed exactly as for calcAutoContrastThreshold()
+    const auto fetchStrip = [&getLuminance, W](int top, int height, std::vector<float> &buffer, std::vector<float*> &rows) {
+        buffer.resize(static_cast<size_t>(W) * height);
+        rows.resize(height);
+        for (int k = 0; k < height; ++k) {
+            rows[k] = &buffer[static_cast<size_t>(k) * W];
+            getLuminance(top + k, 0, W, rows[k]);
+        }
+    };
+
+    for (int pass = 0; pass < 2; ++pass) {
+        const int tilesize = 80 / (pass + 1);
+        const int skip = pass == 0 ? tilesize : tilesize / 4;
+        const int numTilesW = W / skip - 3 * pass;
+        const int numTilesH = H / skip - 3 * pass;
+        std::vector<std::vector<float>> variances(numTilesH, std::vector<float>(numTilesW));
+
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        {
+            std::vector<float> buffer;
+            std::vector<float*> rows;
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic)
 #endif
             for (int i = 0; i < numTilesH; ++i) {
-                const int tileY = i * skip;
+                fetchStrip(i * skip, tilesize, buffer, rows);
                 for (int j = 0; j < numTilesW; ++j) {
                     const int tileX = j * skip;
-                    const float avg = tileAverage(luminance, tileY, tileX, tilesize);
+                    const float avg = tileAverage(rows.data(), 0, tileX, tilesize);
                     if (avg < minLuminance || avg > maxLuminance) {
                         // too dark or too bright => skip the tile
                         variances[i][j] = RT_INFINITY_F;
                         continue;
                     } else {
-                        variances[i][j] = tileVariance(luminance, tileY, tileX, tilesize, avg);
+                        variances[i][j] = tileVariance(rows.data(), 0, tileX, tilesize, avg);
                         // exclude tiles with a variance less than minTileVariance
                         variances[i][j] = variances[i][j] < minTileVariance ? RT_INFINITY_F : variances[i][j];
                     }
                 }
             }
+        }
 
-            float minvar = RT_INFINITY_F;
-            int minI = 0, minJ = 0;
-            for (int i = 0; i < numTilesH; ++i) {
-                for (int j = 0; j < numTilesW; ++j) {
-                    if (variances[i][j] < minvar) {
-                        minvar = variances[i][j];
-                        minI = i;
-                        minJ = j;
-                    }
+        float minvar = RT_INFINITY_F;
+        int minI = 0, minJ = 0;
+        for (int i = 0; i < numTilesH; ++i) {
+            for (int j = 0; j < numTilesW; ++j) {
+                if (variances[i][j] < minvar) {
+                    minvar = variances[i][j];
+                    minI = i;
+                    minJ = j;
                 }
             }
+        }
 
-            if (minvar <= 1.f || pass == 1) {
-                const int minY = skip * minI;
-                const int minX = skip * minJ;
-                if (pass == 0) {
-                    // a variance <= 1 means we already found a flat region and can skip second pass
-                    contrastThreshold = calcContrastThreshold(luminance, minY, minX, tilesize);
-                    break;
-                } else {
-                    // in second pass we allow a variance of 8
-                    // we additionally scan the tiles +-skip pixels around the best tile from pass 2
-                    // Means we scan (2 * skip + 1)^2 tiles in this step to get a better hit rate
-                    // fortunately the scan is quite fast, so we use only one core and don't parallelize
-                    const int topLeftYStart = std::max(minY - skip, 0);
-                    const int topLeftXStart = std::max(minX - skip, 0);
-                    const int topLeftYEnd = std::min(minY + skip, H - tilesize);
-                    const int topLeftXEnd = std::min(minX + skip, W - tilesize);
-                    const int numTilesH = topLeftYEnd - topLeftYStart + 1;
-                    const int numTilesW = topLeftXEnd - topLeftXStart + 1;
-
-                    std::vector<std::vector<float>> variances(numTilesH, std::vector<float>(numTilesW));
-                    for (int i = 0; i < numTilesH; ++i) {
-                        const int tileY = topLeftYStart + i;
-                        for (int j = 0; j < numTilesW; ++j) {
-                            const int tileX = topLeftXStart + j;
-                            const float avg = tileAverage(luminance, tileY, tileX, tilesize);
-
-                            if (avg < minLuminance || avg > maxLuminance) {
-                                // too dark or too bright => skip the tile
-                                variances[i][j] = RT_INFINITY_F;
-                                continue;
-                            } else {
-                                variances[i][j] = tileVariance(luminance, tileY, tileX, tilesize, avg);
+        if (minvar <= 1.f || pass == 1) {
+            const int minY = skip * minI;
+            const int minX = skip * minJ;
+            std::vector<float> buffer;
+            std::vector<float*> rows;
+            if (pass == 0) {
+                // a variance <= 1 means we already found a flat region and can skip second pass
+                fetchStrip(minY, tilesize, buffer, rows);
+                return calcContrastThreshold(rows.data(), 0, minX, tilesize);
+            } else {
+                // in second pass we allow a variance of 8
+                // we additionally scan the tiles +-skip pixels around the best tile from pass 2
+                const int topLeftYStart = std::max(minY - skip, 0);
+                const int topLeftXStart = std::max(minX - skip, 0);
+                const int topLeftYEnd = std::min(minY + skip, H - tilesize);
+                const int topLeftXEnd = std::min(minX + skip, W - tilesize);
+                const int numTilesH = topLeftYEnd - topLeftYStart + 1;
+                const int numTilesW = topLeftXEnd - topLeftXStart + 1;
+                fetchStrip(topLeftYStart, numTilesH + tilesize - 1, buffer, rows);
+
+                std::vector<std::vector<float>> variances(numTilesH, std::vector<float>(numTilesW));
+                for (int i = 0; i < numTilesH; ++i) {
+                    for (int j = 0; j < numTilesW; ++j) {
+                        const int tileX = topLeftXStart + j;
+                        const float avg = tileAverage(rows.data(), i, tileX, tilesize);
+
+                        if (avg < minLuminance || avg > maxLuminance) {
+                            // too dark or too bright => skip the tile
+                            variances[i][j] = RT_INFINITY_F;
+                            continue;
+                        } else {
+                            variances[i][j] = tileVariance(rows.data(), i, tileX, tilesize, avg);
                             // exclude tiles with a variance less than minTileVariance
                             variances[i][j] = variances[i][j] < minTileVariance ? RT_INFINITY_F : variances[i][j];
-                            }
                         }
                     }
+                }
 
-                    float minvar = RT_INFINITY_F;
-                    int minI = 0, minJ = 0;
-                    for (int i = 0; i < numTilesH; ++i) {
-                        for (int j = 0; j < numTilesW; ++j) {
-                            if (variances[i][j] < minvar) {
-                                minvar = variances[i][j];
-                                minI = i;
-                                minJ = j;
-                            }
+                float minvar = RT_INFINITY_F;
+                int minI = 0, minJ = 0;
+                for (int i = 0; i < numTilesH; ++i) {
+                    for (int j = 0; j < numTilesW; ++j) {
+                        if (variances[i][j] < minvar) {
+                            minvar = variances[i][j];
+                            minI = i;
+                            minJ = j;
                         }
                     }
-
-                    contrastThreshold = minvar <= 8.f ? calcContrastThreshold(luminance, topLeftYStart + minI, topLeftXStart + minJ, tilesize) : 0.f;
                 }
+
+                return minvar <= 8.f ? calcContrastThreshold(rows.data(), minI, topLeftXStart + minJ, tilesize) : 0.f;
             }
         }
     }
 
+    return 0.f;
+}
+
+void buildBlendMask(const float* const * luminance, float **blend, int W, int H, float &contrastThreshold, bool autoContrast, float ** clipMask) {
+
+    if (autoContrast) {
+        contrastThreshold = calcAutoContrastThreshold(luminance, W, H);
+    }
+
     if(contrastThreshold == 0.f) {
         for(int j = 0; j < H; ++j) {
             for(int i = 0; i < W; ++i) {
@@ -398,83 +599,59 @@ void buildBlendMask(const float* const * luminance, float **blend, int W, int H,
             }
         }
     } else {
-        constexpr float scale = 0.0625f / 327.68f;
 #ifdef _OPENMP
         #pragma omp parallel
 #endif
         {
-#ifdef __SSE2__
-            const vfloat contrastThresholdv = F2V(contrastThreshold);
-            const vfloat scalev = F2V(scale);
-#endif
 #ifdef _OPENMP
             #pragma omp for schedule(dynamic,16)
 #endif
 
             for(int j = 2; j < H - 2; ++j) {
-                int i = 2;
-#ifdef __SSE2__
-                if (clipMask) {
-                    for(; i < W - 5; i += 4) {
-                        vfloat contrastv = vsqrtf(SQRV(LVFU(luminance[j][i+1]) - LVFU(luminance[j][i-1])) + SQRV(LVFU(luminance[j+1][i]) - LVFU(luminance[j-1][i])) +
-                                                  SQRV(LVFU(luminance[j][i+2]) - LVFU(luminance[j][i-2])) + SQRV(LVFU(luminance[j+2][i]) - LVFU(luminance[j-2][i]))) * scalev;
-
-                        STVFU(blend[j][i], LVFU(clipMask[j][i]) * calcBlendFactor(contrastv, contrastThresholdv));
-                    }
-                } else {
-                    for(; i < W - 5; i += 4) {
-                        vfloat contrastv = vsqrtf(SQRV(LVFU(luminance[j][i+1]) - LVFU(luminance[j][i-1])) + SQRV(LVFU(luminance[j+1][i]) - LVFU(luminance[j-1][i])) +
-                                                  SQRV(LVFU(luminance[j][i+2]) - LVFU(luminance[j][i-2])) + SQRV(LVFU(luminance[j+2][i]) - LVFU(luminance[j-2][i]))) * scalev;
+                calcBlendFactorRow(luminance + j, blend[j], clipMask ? clipMask[j] : nullptr, W, contrastThreshold);
+            }
 
-                        STVFU(blend[j][i], calcBlendFactor(contrastv, contrastThresholdv));
-                    }
-                }
-#endif
-                for(; i < W - 2; ++i) {
+            smoothBlendMask(blend, W, H);
+        }
+    }
+}
 
-                    float contrast = sqrtf(rtengine::SQR(luminance[j][i+1] - luminance[j][i-1]) + rtengine::SQR(luminance[j+1][i] - luminance[j-1][i]) + 
-                                           rtengine::SQR(luminance[j][i+2] - luminance[j][i-2]) + rtengine::SQR(luminance[j+2][i] - luminance[j-2][i])) * scale;
+void buildBlendMaskTiled(const std::function<void(int row, int col, int width, float* luminance)>& getLuminance, float **blend, int W, int H, float contrastThreshold) {
 
-                    blend[j][i] = (clipMask ? clipMask[j][i] : 1.f) * calcBlendFactor(contrast, contrastThreshold);
-                }
+    if(contrastThreshold == 0.f) {
+        for(int j = 0; j < H; ++j) {
+            for(int i = 0; i < W; ++i) {
+                blend[j][i] = 1.f;
             }
-
+        }
+    } else {
+        constexpr int stripHeight = 32;
 #ifdef _OPENMP
-            #pragma omp single
+        #pragma omp parallel
 #endif
-            {
-                // upper border
-                for(int j = 0; j < 2; ++j) {
-                    for(int i = 2; i < W - 2; ++i) {
-                        blend[j][i] = blend[2][i];
-                    }
-                }
-                // lower border
-                for(int j = H - 2; j < H; ++j) {
-                    for(int i = 2; i < W - 2; ++i) {
-                        blend[j][i] = blend[H-3][i];
-                    }
-                }
-                for(int j = 0; j < H; ++j) {
-                    // left border
-                    blend[j][0] = blend[j][1] = blend[j][2];
-                    // right border
-                    blend[j][W - 2] = blend[j][W - 1] = blend[j][W - 3];
-                }
+        {
+            // luminance of the rows of a strip and of the 2 rows above and below it.
+            // The rows have the full width, so the luminance and the blend factors are computed as in buildBlendMask()
+            std::vector<float> luminance((stripHeight + 4) * W);
+            std::vector<float*> rows(stripHeight + 4);
+            for(int k = 0; k < stripHeight + 4; ++k) {
+                rows[k] = &luminance[k * W];
             }
-
-#ifdef __SSE2__
-            // flush denormals to zero for gaussian blur to avoid performance penalty if there are a lot of zero values in the mask
-            const auto oldMode = _MM_GET_FLUSH_ZERO_MODE();
-            _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+#ifdef _OPENMP
+            #pragma omp for schedule(dynamic)
 #endif
 
-            // blur blend mask to smooth transitions
-            gaussianBlur(blend, blend, W, H, 2.0);
+            for(int top = 2; top < H - 2; top += stripHeight) {
+                const int bottom = std::min(top + stripHeight, H - 2);
+                for(int j = top - 2; j < bottom + 2; ++j) {
+                    getLuminance(j, 0, W, rows[j - top + 2]);
+                }
+                for(int j = top; j < bottom; ++j) {
+                    calcBlendFactorRow(rows.data() + j - top + 2, blend[j], nullptr, W, contrastThreshold);
+                }
+            }
 
-#ifdef __SSE2__
-            _MM_SET_FLUSH_ZERO_MODE(oldMode);
-#endif
+            smoothBlendMask(blend, W, H);
         }
     }
 }
@@ -500,4 +677,32 @@ double accumulateProduct(const float* data1, const float* data2, size_t n, bool
     }
     return acc1 + acc2;
 }
+
+std::uint64_t hashPlane(const float* const * data, int W, int H, bool multiThread) {
+    // FNV-1a of the rows, combined in order
+    std::vector<std::uint64_t> rowHashes(H);
+
+#ifdef _OPENMP
+    #pragma omp parallel for if(multiThread)
+#endif
+    for (int i = 0; i < H; ++i) {
+        std::uint64_t hash = 14695981039346656037ULL;
+
+        for (int j = 0; j < W; ++j) {
+            std::uint32_t bits;
+            memcpy(&bits, &data[i][j], sizeof(bits));
+            hash = (hash ^ bits) * 1099511628211ULL;
+        }
+
+        rowHashes[i] = hash;
+    }
+
+    std::uint64_t hash = 14695981039346656037ULL;
+
+    for (const auto rowHash : rowHashes) {
+        hash = (hash ^ rowHash) * 1099511628211ULL;
+    }
+
+    return hash;
+}
 }
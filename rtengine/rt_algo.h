@@ -20,14 +20,25 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 
 namespace rtengine
 {
 void findMinMaxPercentile(const float* data, size_t size, float minPrct, float& minOut, float maxPrct, float& maxOut, bool multiThread = true);
 void buildBlendMask(const float* const * luminance, float **blend, int W, int H, float &contrastThreshold, bool autoContrast = false, float ** clipmask = nullptr);
+float calcAutoContrastThreshold(const float* const * luminance, int W, int H);
+// Same result as calcAutoContrastThreshold(), but gets the luminance of strips of rows from getLuminance(row, col, width, dst),
+// which is called from several threads. Saves the luminance buffer of the whole image.
+float calcAutoContrastThresholdTiled(const std::function<void(int row, int col, int width, float* luminance)>& getLuminance, int W, int H);
+// Same result as buildBlendMask() without auto contrast, but gets the luminance of strips of rows from
+// getLuminance(row, col, width, dst), which is called from several threads. Saves the luminance buffer of the whole image.
+void buildBlendMaskTiled(const std::function<void(int row, int col, int width, float* luminance)>& getLuminance, float **blend, int W, int H, float contrastThreshold);
 // implemented in tmo_fattal02
 void buildGradientsMask(int W, int H, float **luminance, float **out, 
                         float amount, int nlevels, int detail_level,
                         float alfa, float beta, bool multithread);
 double accumulateProduct(const float* data1, const float* data2, size_t n, bool multiThread = true);
+// Hash of the bit patterns of the values, to recognize unchanged data
+std::uint64_t hashPlane(const float* const * data, int W, int H, bool multiThread = true);
 }
@@ -184,6 +184,13 @@ public:
       * @param firstFrameOnly must be true to get the MetaData of the first frame only, e.g. for a PixelShift file.
       * @return The metadata */
     static FramesMetaData* fromFile (const Glib::ustring& fname, std::unique_ptr<RawMetaDataLocation> rml, bool firstFrameOnly = false);
+    /** Reads the basic shooting information of a raw file (date, camera, lens, exposure, orientation and rating)
+      * from the first few hundred KB of the file, without parsing the whole IFD tree and the makernotes.
+      * Frame count, HDR, PixelShift and sample format are not detected, and no exif directory is available.
+      * @param fname is the name of the file
+      * @return The metadata, or NULL if the file needs to be read with fromFile(), e.g. because its
+      * layout is not supported or because the lens of this camera maker is only found in the makernotes */
+    static FramesMetaData* fromFileQuick (const Glib::ustring& fname);
 };
 
 /** This listener interface is used to indicate the progress of time consuming operations */
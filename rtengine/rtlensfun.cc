@@ -313,28 +313,44 @@ bool LFLens::hasCACorrection() const
 // LFDatabase
 //-----------------------------------------------------------------------------
 
+MyMutex LFDatabase::initMutex_;
 LFDatabase LFDatabase::instance_;
 
 
 bool LFDatabase::init(const Glib::ustring &dbdir)
 {
-    instance_.data_ = lfDatabase::Create();
+    MyMutex::MyLock lock(initMutex_);
+
+    instance_.dbdir_ = dbdir;
+    instance_.loaded_ = false;
+    return true;
+}
+
+
+bool LFDatabase::load()
+{
+    if (data_) {
+        MyMutex::MyLock lock(lfDBMutex);
+        data_->Destroy();
+    }
+
+    data_ = lfDatabase::Create();
 
     if (settings->verbose) {
         std::cout << "Loading lensfun database from ";
-        if (dbdir.empty()) {
+        if (dbdir_.empty()) {
             std::cout << "the default directories";
         } else {
-            std::cout << "'" << dbdir << "'";
+            std::cout << "'" << dbdir_ << "'";
         }
         std::cout << "..." << std::flush;
     }
 
     bool ok = false;
-    if (dbdir.empty()) {
-        ok = (instance_.data_->Load() ==  LF_NO_ERROR);
+    if (dbdir_.empty()) {
+        ok = (data_->Load() ==  LF_NO_ERROR);
     } else {
-        ok = instance_.LoadDirectory(dbdir.c_str());
+        ok = LoadDirectory(dbdir_.c_str());
     }
 
     if (settings->verbose) {
@@ -348,7 +364,7 @@ bool LFDatabase::init(const Glib::ustring &dbdir)
 bool LFDatabase::LoadDirectory(const char *dirname)
 {
 #if RT_LENSFUN_HAS_LOAD_DIRECTORY
-    return instance_.data_->LoadDirectory(dirname);
+    return data_->LoadDirectory(dirname);
 #else
     // backported from lensfun 0.3.x
     bool database_found = false;
@@ -383,7 +399,8 @@ bool LFDatabase::LoadDirectory(const char *dirname)
 
 
 LFDatabase::LFDatabase():
-    data_(nullptr)
+    data_(nullptr),
+    loaded_(true)
 {
 }
 
@@ -399,6 +416,13 @@ LFDatabase::~LFDatabase()
 
 const LFDatabase *LFDatabase::getInstance()
 {
+    MyMutex::MyLock lock(initMutex_);
+
+    if (!instance_.loaded_) {
+        instance_.loaded_ = true;
+        instance_.load();
+    }
+
     return &instance_;
 }
 
@@ -113,6 +113,7 @@ class LFDatabase final :
     public NonCopyable
 {
 public:
+    // only remembers the directory, the database is loaded on the first call of getInstance()
     static bool init(const Glib::ustring &dbdir);
     static const LFDatabase *getInstance();
 
@@ -136,11 +137,15 @@ private:
                                             float focalLen, float aperture, float focusDist,
                                             int width, int height, bool swap_xy) const;
     LFDatabase();
+    bool load();
     bool LoadDirectory(const char *dirname);
 
     mutable MyMutex lfDBMutex;
+    static MyMutex initMutex_;
     static LFDatabase instance_;
     lfDatabase *data_;
+    Glib::ustring dbdir_;
+    bool loaded_;
     mutable std::set<std::string> notFound;
 };
 
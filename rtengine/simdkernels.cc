@@ -0,0 +1,76 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "simdkernels.h"
+
+namespace rtengine
+{
+
+namespace simd
+{
+
+#ifdef RT_SIMD_DISPATCH_AVX2
+extern const Kernels kernelsAvx2;
+#endif
+#ifdef RT_SIMD_DISPATCH_AVX512
+extern const Kernels kernelsAvx512;
+#endif
+
+namespace
+{
+
+const Kernels* selectKernels()
+{
+    const char* forced = std::getenv("RT_SIMD");
+    const Kernels* kernels = nullptr;
+
+#if defined(RT_SIMD_DISPATCH_AVX2) || defined(RT_SIMD_DISPATCH_AVX512)
+    __builtin_cpu_init();
+#endif
+
+#ifdef RT_SIMD_DISPATCH_AVX2
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && (!forced || !std::strcmp(forced, "avx2") || !std::strcmp(forced, "avx512"))) {
+        kernels = &kernelsAvx2;
+    }
+#endif
+#ifdef RT_SIMD_DISPATCH_AVX512
+    if (kernels && __builtin_cpu_supports("avx512f") && (!forced || !std::strcmp(forced, "avx512"))) {
+        kernels = &kernelsAvx512;
+    }
+#endif
+
+    if (forced && std::strcmp(forced, kernels ? kernels->name : "sse2")) {
+        fprintf(stderr, "RT_SIMD=%s is not available, using %s kernels\n", forced, kernels ? kernels->name : "sse2");
+    }
+
+    return kernels;
+}
+
+}
+
+const Kernels* getKernels()
+{
+    static const Kernels* const kernels = selectKernels();
+    return kernels;
+}
+
+}
+
+}
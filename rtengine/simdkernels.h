@@ -0,0 +1,50 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+namespace rtengine
+{
+
+namespace simd
+{
+
+/*
+  Variants of some hot kernels compiled for instruction sets wider than the one of the build (AVX2, AVX-512),
+  so that generic builds use them on cpus supporting them. The variant is selected once, according to the cpu,
+  unless the RT_SIMD environment variable forces one ("sse2" for the code of the build, "avx2" or "avx512").
+  getKernels() returns nullptr if the code of the build has to be used, callers keep their own code path for it.
+*/
+struct Kernels {
+    const char* name;
+
+    // vertical pass of the recursive gaussian blur (see gaussVerticalSse() in gauss.cc), src may be dst
+    void (*gaussVertical)(float** src, float** dst, int W, int H, float B, float b1, float b2, float b3, const float M[3][3]);
+
+    // Color::RGB2Lab() for a row, lutf and lutfy are the data of Color::cachef and Color::cachefy.
+    // outOfRange is called for the pixels whose xyz values are outside of the luts
+    void (*rgb2lab)(const float* R, const float* G, const float* B, float* L, float* a, float* b, const float wp[3][3], int width,
+                    const float* lutf, const float* lutfy, void (*outOfRange)(float x, float y, float z, float& L, float& a, float& b));
+
+    // Color::Lab2RGBLimit() for a row
+    void (*lab2rgbLimit)(const float* L, const float* a, const float* b, float* R, float* G, float* B, const float wp[3][3], float limit, float afactor, float bfactor, int width);
+};
+
+const Kernels* getKernels();
+
+}
+
+}
@@ -0,0 +1,23 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// AVX-512 variant of the kernels of simdkernels.h, compiled with the flags set in CMakeLists.txt
+#define SIMD_KERNELS_NAME kernelsAvx512
+#define SIMD_KERNELS_LABEL "avx512"
+#define SIMD_KERNELS_WIDTH 32
+
+#include "simdkernels_impl.h"
@@ -0,0 +1,224 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+  Bodies of the kernels of simdkernels.h, included by one simdkernels_<isa>.cc file per instruction set, which defines
+  SIMD_KERNELS_NAME (name of the table), SIMD_KERNELS_LABEL and SIMD_KERNELS_WIDTH (number of floats the loops are
+  blocked by) and is compiled with the flags of its instruction set. The loops are written for the auto-vectorizer.
+
+  Only call functions with internal linkage here: the copy of an inline function or template of another header
+  (std::min, LUT, Color...) compiled in these files may be the one the linker keeps for the whole program, which
+  would then crash on cpus without the instruction set. The constants of Color are fine.
+*/
+
+#include "color.h"
+#include "opthelper.h"
+#include "simdkernels.h"
+
+namespace
+{
+
+constexpr int WIDTH = SIMD_KERNELS_WIDTH;
+
+// Young & van Vliet recursive gaussian, vertical pass of the N columns starting at x, tmp has N * H elements
+template<int N>
+inline void gaussVerticalColumns(float** src, float** dst, int x, int H, float B, float b1, float b2, float b3, const float M[3][3], float* RESTRICT tmp)
+{
+    for (int k = 0; k < N; ++k) {
+        tmp[k] = src[0][x + k] * (B + b1 + b2 + b3);
+        tmp[N + k] = B * src[1][x + k] + b1 * tmp[k] + src[0][x + k] * (b2 + b3);
+        tmp[2 * N + k] = B * src[2][x + k] + b1 * tmp[N + k] + b2 * tmp[k] + b3 * src[0][x + k];
+    }
+
+    for (int j = 3; j < H; ++j) {
+        const float* const s = src[j] + x;
+        float* const r = tmp + j * N;
+
+        for (int k = 0; k < N; ++k) {
+            r[k] = B * s[k] + b1 * r[k - N] + b2 * r[k - 2 * N] + b3 * r[k - 3 * N];
+        }
+    }
+
+    // boundary values of the backward pass (Triggs & Sdika)
+    {
+        const float* const s = src[H - 1] + x;
+        float* const r1 = tmp + (H - 1) * N;
+        float* const r2 = tmp + (H - 2) * N;
+        float* const r3 = tmp + (H - 3) * N;
+
+        for (int k = 0; k < N; ++k) {
+            const float v = s[k];
+            const float d1 = r1[k] - v;
+            const float d2 = r2[k] - v;
+            const float d3 = r3[k] - v;
+            const float temp2Hm1 = v + M[0][0] * d1 + M[0][1] * d2 + M[0][2] * d3;
+            const float temp2H = v + M[1][0] * d1 + M[1][1] * d2 + M[1][2] * d3;
+            const float temp2Hp1 = v + M[2][0] * d1 + M[2][1] * d2 + M[2][2] * d3;
+            r1[k] = temp2Hm1;
+            r2[k] = B * r2[k] + b1 * temp2Hm1 + b2 * temp2H + b3 * temp2Hp1;
+            r3[k] = B * r3[k] + b1 * r2[k] + b2 * temp2Hm1 + b3 * temp2H;
+        }
+    }
+
+    // src is not read anymore, src may be dst
+    for (int j = H - 1; j >= H - 3; --j) {
+        for (int k = 0; k < N; ++k) {
+            dst[j][x + k] = tmp[j * N + k];
+        }
+    }
+
+    for (int j = H - 4; j >= 0; --j) {
+        float* const r = tmp + j * N;
+        float* const d = dst[j] + x;
+
+        for (int k = 0; k < N; ++k) {
+            r[k] = B * r[k] + b1 * r[k + N] + b2 * r[k + 2 * N] + b3 * r[k + 3 * N];
+            d[k] = r[k];
+        }
+    }
+}
+
+void gaussVertical(float** src, float** dst, int W, int H, float B, float b1, float b2, float b3, const float M[3][3])
+{
+    float* const tmp = new float[H * WIDTH];
+
+#ifdef _OPENMP
+    #pragma omp for nowait
+#endif
+
+    for (int x = 0; x < W - WIDTH + 1; x += WIDTH) {
+        gaussVerticalColumns<WIDTH>(src, dst, x, H, B, b1, b2, b3, M, tmp);
+    }
+
+#ifdef _OPENMP
+    #pragma omp for
+#endif
+
+    for (int x = W - W % WIDTH; x < W; ++x) {
+        gaussVerticalColumns<1>(src, dst, x, H, B, b1, b2, b3, M, tmp);
+    }
+
+    delete[] tmp;
+}
+
+inline float lutLookup(const float* lut, float maxIndex, float f)
+{
+    const int idx = f > maxIndex ? maxIndex : f;
+    const float diff = f - idx;
+    return lut[idx] + (lut[idx + 1] - lut[idx]) * diff;
+}
+
+void rgb2lab(const float* R, const float* G, const float* B, float* L, float* a, float* b, const float wp[3][3], int width,
+             const float* lutf, const float* lutfy, void (*outOfRange)(float x, float y, float z, float& L, float& a, float& b))
+{
+    constexpr float maxVal = rtengine::MAXVALF;
+    constexpr float maxIndex = rtengine::MAXVALF - 1.f; // the luts have 65536 entries
+
+    int i = 0;
+
+    for (; i < width - WIDTH + 1; i += WIDTH) {
+        float x[WIDTH], y[WIDTH], z[WIDTH];
+        bool outside = false;
+
+        for (int k = 0; k < WIDTH; ++k) {
+            const float rv = R[i + k];
+            const float gv = G[i + k];
+            const float bv = B[i + k];
+            x[k] = wp[0][0] * rv + wp[0][1] * gv + wp[0][2] * bv;
+            y[k] = wp[1][0] * rv + wp[1][1] * gv + wp[1][2] * bv;
+            z[k] = wp[2][0] * rv + wp[2][1] * gv + wp[2][2] * bv;
+            outside |= (x[k] < 0.f) | (y[k] < 0.f) | (z[k] < 0.f) | (x[k] > maxVal) | (y[k] > maxVal) | (z[k] > maxVal);
+        }
+
+        if (outside) {
+            // rare, take the slower path for the whole block
+            for (int k = 0; k < WIDTH; ++k) {
+                outOfRange(x[k], y[k], z[k], L[i + k], a[i + k], b[i + k]);
+            }
+        } else {
+            for (int k = 0; k < WIDTH; ++k) {
+                const float fx = lutLookup(lutf, maxIndex, x[k]);
+                const float fy = lutLookup(lutf, maxIndex, y[k]);
+                const float fz = lutLookup(lutf, maxIndex, z[k]);
+                L[i + k] = lutLookup(lutfy, maxIndex, y[k]);
+                a[i + k] = 500.f * (fx - fy);
+                b[i + k] = 200.f * (fy - fz);
+            }
+        }
+    }
+
+    for (; i < width; ++i) {
+        const float rv = R[i];
+        const float gv = G[i];
+        const float bv = B[i];
+        outOfRange(wp[0][0] * rv + wp[0][1] * gv + wp[0][2] * bv, wp[1][0] * rv + wp[1][1] * gv + wp[1][2] * bv, wp[2][0] * rv + wp[2][1] * gv + wp[2][2] * bv, L[i], a[i], b[i]);
+    }
+}
+
+inline float f2xyz(float f)
+{
+    return f > rtengine::Color::epsilonExpInv3f ? f * f * f : (116.f * f - 16.f) * rtengine::Color::kappaInvf;
+}
+
+void lab2rgbLimit(const float* L, const float* a, const float* b, float* R, float* G, float* B, const float wp[3][3], float limit, float afactor, float bfactor, int width)
+{
+    using rtengine::Color;
+
+    for (int i = 0; i < width; ++i) {
+        float av = a[i];
+        float bv = b[i];
+
+        if (av * av + bv * bv > limit) {
+            av *= afactor;
+            bv *= bfactor;
+        }
+
+        // Color::Lab2XYZ()
+        const float LL = L[i] / 327.68f;
+        const float fy = Color::c1By116 * LL + Color::c16By116;
+        const float fx = 0.002f * (av / 327.68f) + fy;
+        const float fz = fy - 0.005f * (bv / 327.68f);
+        const float X = 65535.f * f2xyz(fx) * Color::D50x;
+        const float Z = 65535.f * f2xyz(fz) * Color::D50z;
+        const float Y = LL > Color::epskapf ? 65535.f * fy * fy * fy : 65535.f * LL / Color::kappaf;
+
+        R[i] = wp[0][0] * X + wp[0][1] * Y + wp[0][2] * Z;
+        G[i] = wp[1][0] * X + wp[1][1] * Y + wp[1][2] * Z;
+        B[i] = wp[2][0] * X + wp[2][1] * Y + wp[2][2] * Z;
+    }
+}
+
+}
+
+namespace rtengine
+{
+
+namespace simd
+{
+
+extern const Kernels SIMD_KERNELS_NAME;
+
+const Kernels SIMD_KERNELS_NAME = {
+    SIMD_KERNELS_LABEL,
+    gaussVertical,
+    rgb2lab,
+    lab2rgbLimit
+};
+
+}
+
+}
@@ -72,6 +72,8 @@ public:
         pl(pl),
         flush(flush),
         // internal state
+        tilingAllowed(false),
+        tiled(false),
         initialImage(nullptr),
         imgsrc(nullptr),
         fw(0),
@@ -119,10 +121,16 @@ public:
 private:
     Imagefloat *normal_pipeline()
     {
+        tilingAllowed = true;
+
         if (!stage_init()) {
             return nullptr;
         }
 
+        if (tiled) {
+            return stage_tiled();
+        }
+
         stage_denoise();
         stage_transform();
         return stage_finish();
@@ -755,8 +763,16 @@ private:
             //end evaluate noise
         }
 
-        baseImg = new Imagefloat(fw, fh);
-        imgsrc->getImage(currWB, tr, baseImg, pp, params.toneCurve, params.raw);
+        tiled = tilingAllowed && options.exportTileSize > 0 && canProcessTiled();
+
+        if (tiled) {
+            if (settings->verbose) {
+                printf("Processing the image in tiles of %dx%d pixels\n", options.exportTileSize, options.exportTileSize);
+            }
+        } else {
+            baseImg = new Imagefloat(fw, fh);
+            imgsrc->getImage(currWB, tr, baseImg, pp, params.toneCurve, params.raw);
+        }
 
         if (pl) {
             pl->setProgress(0.50);
@@ -804,7 +820,8 @@ private:
         // at this stage, we can flush the raw data to free up quite an important amount of memory
         // commented out because it makes the application crash when batch processing...
         // TODO: find a better place to flush rawData and rawRGB
-        if (flush) {
+        // the tiled pipeline still reads the demosaiced planes, it flushes them after the last tile
+        if (flush && !tiled) {
             imgsrc->flush();
         }
 
@@ -1770,6 +1787,19 @@ private:
             pl->setProgress(0.70);
         }
 
+        return stage_output(readyImg);
+    }
+
+    // Resizes the output image with the nearest neighbour method, attaches the metadata and the output profile,
+    // and releases the job.
+    Imagefloat *stage_output(Imagefloat *readyImg)
+    {
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = * (ipf_p.get());
+
+        int imw, imh;
+        const double tmpScale = ipf.resizeScale(&params, fw, fh, imw, imh);
+
         if (tmpScale != 1.0 && params.resize.method == "Nearest" &&
                 (params.resize.allowUpscaling || (readyImg->getWidth() >= imw && readyImg->getHeight() >= imh))) { // resize rgb data (gamma applied)
             Imagefloat* tempImage = new Imagefloat(imw, imh);
@@ -1849,6 +1879,251 @@ private:
         return readyImg;
     }
 
+    // Returns true if all the enabled tools can be processed tile by tile: the pointwise tools and the sharpening tools,
+    // whose support is bounded. The tools which need the whole image (transform, denoise, wavelets, CIECAM...) fall back
+    // to the full frame pipeline.
+    bool canProcessTiled() const
+    {
+        const procparams::ProcParams& params = job->pparams;
+
+        const bool wholeImageTool =
+            params.dirpyrDenoise.enabled
+            || (params.spot.enabled && !params.spot.entries.empty())
+            || params.filmNegative.enabled
+            || params.dehaze.enabled
+            || params.fattal.enabled
+            || params.dirpyrequalizer.enabled
+            || (params.locallab.enabled && !params.locallab.spots.empty())
+            || params.colorToning.enabled
+            || params.blackwhite.enabled
+            || params.sh.enabled
+            || params.localContrast.enabled
+            || params.epd.enabled
+            || params.impulseDenoise.enabled
+            || params.defringe.enabled
+            || params.wavelet.enabled
+            || params.colorappearance.enabled
+            || params.icm.workingTRC != ColorManagementParams::WorkingTrc::NONE
+            || (params.resize.enabled && params.resize.method != "Nearest")
+            || ipf_p->needsTransform(fw, fh, imgsrc->getRotateDegree(), imgsrc->getMetaData());
+
+        if (wholeImageTool || 2 * tileHalo() > options.exportTileSize) {
+            if (settings->verbose) {
+                printf("Tiled processing not possible with the current processing parameters, processing the full image\n");
+            }
+
+            return false;
+        }
+
+        return true;
+    }
+
+    // Number of pixels around a tile which the sharpening tools read to compute the pixels of the tile.
+    // The gaussian blurs are taken as 4 sigma wide.
+    int tileHalo() const
+    {
+        const procparams::ProcParams& params = job->pparams;
+
+        // the contrast based blend masks read 2 pixels around and are smoothed with sigma 2
+        constexpr int blendMaskHalo = 2 + 8;
+        int halo = 0;
+
+        if (params.sharpenEdge.enabled) {
+            halo += 2 * params.sharpenEdge.passes;
+        }
+
+        if (params.sharpenMicro.enabled) {
+            halo += blendMaskHalo + (params.sharpenMicro.matrix ? 1 : 2);
+        }
+
+        if (params.sharpening.enabled) {
+            const SharpeningParams &sharp = params.sharpening;
+            halo += blendMaskHalo;
+
+            if (sharp.blurradius >= 0.25) {
+                halo += std::ceil(4.0 * sharp.blurradius);
+            }
+
+            if (sharp.method == "rld") {
+                // each iteration blurs twice
+                halo += 2 * sharp.deconviter * std::ceil(4.0 * sharp.deconvradius);
+            } else {
+                halo += std::ceil(4.0 * sharp.radius) + (sharp.halocontrol ? 1 : 0);
+
+                if (sharp.edgesonly) {
+                    halo += std::ceil(4.0 * sharp.edges_radius) + 1;
+                }
+            }
+        }
+
+        return halo;
+    }
+
+    // Processes the image in tiles of options.exportTileSize pixels. Each tile is read from the image source with the
+    // halo needed by the sharpening tools, processed up to the output profile and copied into the output image.
+    // The tone curve and L*a*b* curve contrasts, which use the mean of the luminance histogram, get their
+    // histograms from a low resolution analysis pass over the whole image.
+    // Peak memory is the demosaiced planes of the image source and the output image, plus one tile.
+    Imagefloat *stage_tiled()
+    {
+        procparams::ProcParams& params = job->pparams;
+        ImProcFunctions &ipf = * (ipf_p.get());
+
+        const int tileSize = options.exportTileSize;
+
+        // low resolution analysis pass
+        const PreviewProps analysisPP(0, 0, fw, fh, std::max(1, std::max(fw, fh) / tileSize));
+        int aw, ah;
+        imgsrc->getSize(analysisPP, aw, ah);
+        std::unique_ptr<Imagefloat> analysisImg(new Imagefloat(aw, ah));
+        imgsrc->getImage(currWB, tr, analysisImg.get(), analysisPP, params.toneCurve, params.raw);
+        imgsrc->convertColorSpace(analysisImg.get(), params.icm, currWB);
+
+        hist16(65536);
+        ipf.firstAnalysis(analysisImg.get(), params, hist16);
+
+        curve1(65536);
+        curve2(65536);
+        curve(65536, 0);
+        satcurve(65536, 0);
+        lhskcurve(65536, 0);
+        lumacurve(32770, 0);  // lumacurve[32768] and lumacurve[32769] will be set to 32768 and 32769 later to allow linear interpolation
+        clcurve(65536, 0);
+
+        CurveFactory::complexCurve(expcomp, black / 65535.0, hlcompr, hlcomprthresh, params.toneCurve.shcompr, bright, contr,
+                                   params.toneCurve.curve, params.toneCurve.curve2,
+                                   hist16, curve1, curve2, curve, dummy, customToneCurve1, customToneCurve2);
+
+        CurveFactory::RGBCurve(params.rgbCurves.rcurve, rCurve, 1);
+        CurveFactory::RGBCurve(params.rgbCurves.gcurve, gCurve, 1);
+        CurveFactory::RGBCurve(params.rgbCurves.bcurve, bCurve, 1);
+
+        double rrm, ggm, bbm;
+        float autor = 0.f, autog, autob;
+        const float satLimit = float (params.colorToning.satProtectionThreshold) / 100.f * 0.7f + 0.3f;
+        const float satLimitOpacity = 1.f - (float (params.colorToning.saturatedOpacity) / 100.f);
+        DCPProfileApplyState as;
+        DCPProfile *dcpProf = imgsrc->getDCP(params.icm, as);
+        LUTu histToneCurve;
+
+        const auto rgbProc =
+            [&](Imagefloat *working, LabImage *lab)
+            {
+                ipf.rgbProc(working, lab, nullptr, curve1, curve2, curve, params.toneCurve.saturation, rCurve, gCurve, bCurve, satLimit, satLimitOpacity, ctColorCurve, ctOpacityCurve, false, clToningcurve, cl2Toningcurve, customToneCurve1, customToneCurve2, customToneCurvebw1, customToneCurvebw2, rrm, ggm, bbm, autor, autog, autob, expcomp, hlcompr, hlcomprthresh, dcpProf, as, histToneCurve, options.chunkSizeRGB, options.measure);
+            };
+
+        if (params.labCurve.contrast != 0) { //only use hist16 for contrast
+            LabImage analysisLab(aw, ah);
+            rgbProc(analysisImg.get(), &analysisLab);
+            hist16.clear();
+
+            for (int i = 0; i < ah; i++)
+                for (int j = 0; j < aw; j++) {
+                    hist16[(int)((analysisLab.L[i][j]))]++;
+                }
+        }
+
+        analysisImg.reset();
+
+        bool utili;
+        CurveFactory::complexLCurve(params.labCurve.brightness, params.labCurve.contrast, params.labCurve.lcurve, hist16, lumacurve, dummy, 1, utili);
+
+        const bool clcutili = CurveFactory::diagonalCurve2Lut(params.labCurve.clcurve, clcurve, 1);
+
+        bool ccutili, cclutili;
+        CurveFactory::complexsgnCurve(autili, butili, ccutili, cclutili, params.labCurve.acurve, params.labCurve.bcurve, params.labCurve.cccurve,
+                                      params.labCurve.lccurve, curve1, curve2, satcurve, lhskcurve, 1);
+
+        int cx = 0, cy = 0, cw = fw, ch = fh;
+
+        if (params.crop.enabled) {
+            cx = params.crop.x;
+            cy = params.crop.y;
+            cw = params.crop.w;
+            ch = params.crop.h;
+        }
+
+        Imagefloat* readyImg = new Imagefloat(cw, ch);
+
+        const int halo = tileHalo();
+        const int numTilesX = (cw + tileSize - 1) / tileSize;
+        const int numTilesY = (ch + tileSize - 1) / tileSize;
+
+        for (int ty = 0; ty < numTilesY; ++ty) {
+            for (int tx = 0; tx < numTilesX; ++tx) {
+                // the part of the output image computed from this tile, in full image coordinates
+                const int tileX = cx + tx * tileSize;
+                const int tileY = cy + ty * tileSize;
+                const int tileW = std::min(tileSize, cx + cw - tileX);
+                const int tileH = std::min(tileSize, cy + ch - tileY);
+                // the tile with its halo
+                const int x0 = std::max(0, tileX - halo);
+                const int y0 = std::max(0, tileY - halo);
+                const int W = std::min(fw, tileX + tileW + halo) - x0;
+                const int H = std::min(fh, tileY + tileH + halo) - y0;
+
+                std::unique_ptr<LabImage> labTile(new LabImage(W, H));
+                {
+                    Imagefloat tile(W, H);
+                    imgsrc->getImage(currWB, tr, &tile, PreviewProps(x0, y0, W, H, 1), params.toneCurve, params.raw);
+                    imgsrc->convertColorSpace(&tile, params.icm, currWB);
+                    rgbProc(&tile, labTile.get());
+                }
+
+                ipf.chromiLuminanceCurve(nullptr, 1, labTile.get(), labTile.get(), curve1, curve2, satcurve, lhskcurve, clcurve, lumacurve, utili, autili, butili, ccutili, cclutili, clcutili, dummy, dummy);
+                ipf.vibrance(labTile.get(), params.vibrance, params.toneCurve.hrenabled, params.icm.workingProfile);
+
+                if (params.sharpenEdge.enabled) {
+                    ipf.MLsharpen(labTile.get());
+                }
+
+                if (params.sharpenMicro.enabled) {
+                    ipf.MLmicrocontrast(labTile.get());
+                }
+
+                if (params.sharpening.enabled) {
+                    ipf.sharpening(labTile.get(), params.sharpening);
+                }
+
+                ipf.softLight(labTile.get(), params.softlight);
+
+                const std::unique_ptr<Imagefloat> outTile(ipf.lab2rgbOut(labTile.get(), tileX - x0, tileY - y0, tileW, tileH, params.icm));
+                labTile.reset();
+
+#ifdef _OPENMP
+                #pragma omp parallel for
+#endif
+
+                for (int i = 0; i < tileH; ++i) {
+                    for (int j = 0; j < tileW; ++j) {
+                        readyImg->r(tileY - cy + i, tileX - cx + j) = outTile->r(i, j);
+                        readyImg->g(tileY - cy + i, tileX - cx + j) = outTile->g(i, j);
+                        readyImg->b(tileY - cy + i, tileX - cx + j) = outTile->b(i, j);
+                    }
+                }
+
+                if (pl) {
+                    pl->setProgress(0.50 + 0.2 * (ty * numTilesX + tx + 1) / (numTilesX * numTilesY));
+                }
+            }
+        }
+
+        if (settings->verbose) {
+            printf("Output profile_: \"%s\"\n", params.icm.outputProfile.c_str());
+        }
+
+        // if clut was used and size of clut cache == 1 we free the memory used by the clutstore (default clut cache size = 1 for 32 bit OS)
+        if (params.filmSimulation.enabled && !params.filmSimulation.clutFilename.empty() && options.clutCacheSize == 1) {
+            CLUTStore::getInstance().clearCache();
+        }
+
+        if (flush) {
+            imgsrc->flush();
+        }
+
+        return stage_output(readyImg);
+    }
+
     void stage_early_resize()
     {
         procparams::ProcParams& params = job->pparams;
@@ -1989,6 +2264,8 @@ private:
     bool flush;
 
     // internal state
+    bool tilingAllowed;
+    bool tiled;
     std::unique_ptr<ImProcFunctions> ipf_p;
     InitialImage *initialImage;
     ImageSource *imgsrc;
@@ -22,12 +22,47 @@
 #include "rt_math.h"
 
 #include "utils.h"
+#include "../rtgui/version.h"
 
 using namespace std;
 
 namespace rtengine
 {
 
+const std::string& getBuildId()
+{
+    static const std::string id = std::string(RTVERSION)
+#ifdef __VERSION__
+                                  + " " __VERSION__
+#endif
+#ifdef __SSE2__
+                                  + " sse2"
+#endif
+#ifdef __SSE4_1__
+                                  + " sse4.1"
+#endif
+#ifdef __AVX__
+                                  + " avx"
+#endif
+#ifdef __AVX2__
+                                  + " avx2"
+#endif
+#ifdef __FMA__
+                                  + " fma"
+#endif
+#ifdef __AVX512F__
+                                  + " avx512f"
+#endif
+#ifdef __ARM_NEON
+                                  + " neon"
+#endif
+#ifdef __FAST_MATH__
+                                  + " fast-math"
+#endif
+                                  ;
+    return id;
+}
+
 void poke255_uc(unsigned char*& dest, unsigned char r, unsigned char g, unsigned char b)
 {
 #if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
@@ -18,6 +18,7 @@
  */
 #pragma once
 
+#include <string>
 #include <type_traits>
 #include <glibmm/ustring.h>
 
@@ -54,6 +55,10 @@ bool hasPngExtension(const Glib::ustring& filename);
 
 void swab(const void* from, void* to, ssize_t n);
 
+// Version, compiler and the code paths selected by its flags (e.g. SSE2 or native builds). The values of the
+// on disk caches depend on them, so builds sharing a cache folder must not use the files of each other.
+const std::string& getBuildId();
+
 }
 
 #if __SIZEOF_WCHAR_T__ == 4
@@ -19,12 +19,15 @@
 //
 ////////////////////////////////////////////////////////////////
 
+#include <cstring>
+
 #include "color.h"
 #include "rtengine.h"
 #include "rawimage.h"
 #include "rawimagesource.h"
 #include "rt_algo.h"
 #include "rt_math.h"
+#include "xtrans_kernels.h"
 #include "../rtgui/multilangmgr.h"
 #include "opthelper.h"
 #include "StopWatch.h"
@@ -38,6 +41,13 @@ const float xyz_rgb[3][3] = {          // XYZ from RGB
 };
 const float d65_white[3] = { 0.950456, 1, 1.088754 };
 
+namespace
+{
+
+using xtrans::ts;
+
+}
+
 void RawImageSource::cielab (const float (*rgb)[3], float* l, float* a, float *b, const int width, const int height, const int labWidth, const float xyz_cam[3][3])
 {
     static LUTf cbrt(0x14000);
@@ -188,7 +198,6 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
         stop.reset(new StopWatch("xtrans demosaic"));
     }
 
-    constexpr int ts = 114;      /* Tile Size */
     constexpr int tsh = ts / 2;  /* half of Tile Size */
 
     double progress = 0.0;
@@ -727,15 +736,7 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
                         int f = dir[d & 3];
                         f = f == 1 ? 1 : f - 8;
 
-                        for (int row = 5; row < mrow - 5; row++)
-                            for (int col = 5; col < mcol - 5; col++) {
-                                float *y = &yuv[0][row - 4][col - 4];
-                                float *u = &yuv[1][row - 4][col - 4];
-                                float *v = &yuv[2][row - 4][col - 4];
-                                drv[d][row - 5][col - 5] = SQR(2 * y[0] - y[f] - y[-f])
-                                                           + SQR(2 * u[0] - u[f] - u[-f])
-                                                           + SQR(2 * v[0] - v[f] - v[-f]);
-                            }
+                        xtrans::xtransYuvDerivatives(yuv, drv[d], f, mrow, mcol);
                     }
                 }
 
@@ -910,41 +911,7 @@ void RawImageSource::xtrans_interpolate (const int passes, const bool useCieLab,
 
 
                 /* Average the most homogeneous pixels for the final result: */
-                uint8_t hm[8] = {};
-
-                for (int row = MIN(top, 8); row < mrow - 8; row++)
-                    for (int col = MIN(left, 8); col < mcol - 8; col++) {
-
-                        for (int d = 0; d < 4; d++) {
-                            hm[d] = homosum[d][row][col];
-                        }
-
-                        for (int d = 4; d < ndir; d++) {
-                            hm[d] = homosum[d][row][col];
-
-                            if (hm[d - 4] < hm[d]) {
-                                hm[d - 4] = 0;
-                            } else if (hm[d - 4] > hm[d]) {
-                                hm[d] = 0;
-                            }
-                        }
-
-                        float avg[4] = {0.f};
-
-                        uint8_t maxval = homosummax[row][col];
-
-                        for (int d = 0; d < ndir; d++)
-                            if (hm[d] >= maxval) {
-                                for (int c = 0; c < 3; c++) {
-                                    avg[c] += rgb[d][row][col][c];
-                                }
-                                avg[3]++;
-                            }
-
-                        red[row + top][col + left] = std::max(0.f, avg[0] / avg[3]);
-                        green[row + top][col + left] = std::max(0.f, avg[1] / avg[3]);
-                        blue[row + top][col + left] = std::max(0.f, avg[2] / avg[3]);
-                    }
+                xtrans::xtransAverageHomogeneous(rgb, homosum, homosummax, ndir, MIN(top, 8), MIN(left, 8), mrow, mcol, red, green, blue, top, left);
 
                 if(plistenerActive && ((++progressCounter) % 32 == 0)) {
 #ifdef _OPENMP
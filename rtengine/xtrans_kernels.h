@@ -0,0 +1,168 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Kernels of the Markesteijn X-Trans demosaic (xtrans_demosaic.cc) which have an SSE2 and a scalar variant.
+// They only depend on headers, so tools/xtranskernels can compare both variants without linking rtengine.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "opthelper.h"
+#include "rt_math.h"
+
+namespace rtengine
+{
+
+namespace xtrans
+{
+
+constexpr int ts = 114;      /* Tile Size of xtrans_interpolate */
+
+// YPbPr derivatives of one direction (f is the offset of the neighbours in yuv) of a tile.
+// vectorized = false selects the scalar code even in SSE2 builds. Only tools/xtranskernels instantiates it, to check the SSE2 code.
+template<bool vectorized = true>
+inline void xtransYuvDerivatives(const float (*yuv)[ts - 8][ts - 8], float (*drv)[ts - 10], int f, int mrow, int mcol)
+{
+    for (int row = 5; row < mrow - 5; row++) {
+        int col = 5;
+#ifdef __SSE2__
+
+        if (vectorized) {
+            vfloat twov = F2V(2.f);
+
+            for (; col < mcol - 8; col += 4) {
+                const float *y = &yuv[0][row - 4][col - 4];
+                const float *u = &yuv[1][row - 4][col - 4];
+                const float *v = &yuv[2][row - 4][col - 4];
+                vfloat dyv = twov * LVFU(y[0]) - LVFU(y[f]) - LVFU(y[-f]);
+                vfloat duv = twov * LVFU(u[0]) - LVFU(u[f]) - LVFU(u[-f]);
+                vfloat dvv = twov * LVFU(v[0]) - LVFU(v[f]) - LVFU(v[-f]);
+                STVFU(drv[row - 5][col - 5], SQRV(dyv) + SQRV(duv) + SQRV(dvv));
+            }
+        }
+
+#endif
+
+        for (; col < mcol - 5; col++) {
+            const float *y = &yuv[0][row - 4][col - 4];
+            const float *u = &yuv[1][row - 4][col - 4];
+            const float *v = &yuv[2][row - 4][col - 4];
+            drv[row - 5][col - 5] = SQR(2 * y[0] - y[f] - y[-f])
+                                    + SQR(2 * u[0] - u[f] - u[-f])
+                                    + SQR(2 * v[0] - v[f] - v[-f]);
+        }
+    }
+}
+
+// Averages the most homogeneous directions of a tile into red, green and blue at (top, left).
+// vectorized = false selects the scalar code even in SSE2 builds. Only tools/xtranskernels instantiates it, to check the SSE2 code.
+template<bool vectorized = true>
+inline void xtransAverageHomogeneous(const float (*rgb)[ts][ts][3], const uint8_t (*homosum)[ts][ts], const uint8_t (*homosummax)[ts], int ndir,
+                                     int rowStart, int colStart, int mrow, int mcol, float** red, float** green, float** blue, int top, int left)
+{
+    uint8_t hm[8] = {};
+
+    for (int row = rowStart; row < mrow - 8; row++) {
+        int col = colStart;
+#ifdef __SSE2__
+
+        if (vectorized) {
+            // same as the scalar code below, the homogeneity sums of 4 pixels are converted to float
+            // and the directions which don't pass the test are masked out of the sums
+            const vint zeroiv = _mm_setzero_si128();
+            const vfloat zerofv = ZEROV;
+            const vfloat onefv = F2V(1.f);
+
+            for (; col < mcol - 11; col += 4) {
+                vfloat hmv[8];
+
+                for (int d = 0; d < ndir; d++) {
+                    int hmi;
+                    memcpy(&hmi, &homosum[d][row][col], sizeof(hmi));
+                    hmv[d] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(hmi), zeroiv), zeroiv));
+                }
+
+                for (int d = 4; d < ndir; d++) {
+                    const vfloat hmprevv = hmv[d - 4];
+                    hmv[d - 4] = vselfnotzero(vmaskf_lt(hmprevv, hmv[d]), hmprevv);
+                    hmv[d] = vselfnotzero(vmaskf_gt(hmprevv, hmv[d]), hmv[d]);
+                }
+
+                int maxi;
+                memcpy(&maxi, &homosummax[row][col], sizeof(maxi));
+                const vfloat maxvalv = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(maxi), zeroiv), zeroiv));
+                vfloat avgrv = zerofv, avggv = zerofv, avgbv = zerofv, countv = zerofv;
+
+                for (int d = 0; d < ndir; d++) {
+                    const vmask selmask = vmaskf_ge(hmv[d], maxvalv);
+                    vfloat redv, greenv, bluev;
+                    vconvertrgbrgbrgbrgb2rrrrggggbbbb(rgb[d][row][col], redv, greenv, bluev);
+                    avgrv += vselfzero(selmask, redv);
+                    avggv += vselfzero(selmask, greenv);
+                    avgbv += vselfzero(selmask, bluev);
+                    countv += vselfzero(selmask, onefv);
+                }
+
+                STVFU(red[row + top][col + left], vmaxf(zerofv, avgrv / countv));
+                STVFU(green[row + top][col + left], vmaxf(zerofv, avggv / countv));
+                STVFU(blue[row + top][col + left], vmaxf(zerofv, avgbv / countv));
+            }
+        }
+
+#endif
+
+        for (; col < mcol - 8; col++) {
+
+            for (int d = 0; d < 4; d++) {
+                hm[d] = homosum[d][row][col];
+            }
+
+            for (int d = 4; d < ndir; d++) {
+                hm[d] = homosum[d][row][col];
+
+                if (hm[d - 4] < hm[d]) {
+                    hm[d - 4] = 0;
+                } else if (hm[d - 4] > hm[d]) {
+                    hm[d] = 0;
+                }
+            }
+
+            float avg[4] = {0.f};
+
+            uint8_t maxval = homosummax[row][col];
+
+            for (int d = 0; d < ndir; d++)
+                if (hm[d] >= maxval) {
+                    for (int c = 0; c < 3; c++) {
+                        avg[c] += rgb[d][row][col][c];
+                    }
+                    avg[3]++;
+                }
+
+            red[row + top][col + left] = std::max(0.f, avg[0] / avg[3]);
+            green[row + top][col + left] = std::max(0.f, avg[1] / avg[3]);
+            blue[row + top][col + left] = std::max(0.f, avg[2] / avg[3]);
+        }
+    }
+}
+
+}
+
+}
@@ -26,11 +26,21 @@
 #include "config.h"
 #include <gtkmm.h>
 #include <giomm.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <tiffio.h>
 #include <cstring>
 #include <cstdlib>
 #include <locale.h>
+#include "../rtengine/bufferpool.h"
+#include "../rtengine/cJSON.h"
+#include "../rtengine/imagesource.h"
+#include "../rtengine/mytime.h"
+#include "../rtengine/noncopyable.h"
 #include "../rtengine/procparams.h"
 #include "../rtengine/profilestore.h"
 #include "../rtengine/rtengine.h"
@@ -46,13 +56,19 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <glibmm/threads.h>
+#include <unistd.h>
 #else
 #include <windows.h>
 #include <shlobj.h>
 #include <glibmm/thread.h>
+#include <io.h>
 #include "conio.h"
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 // Set this to 1 to make RT work when started with Eclipse and arguments, at least on Windows platform
 #define ECLIPSE_ARGS 0
 
@@ -61,6 +77,8 @@ Glib::ustring argv0;
 Glib::ustring creditsPath;
 Glib::ustring licensePath;
 Glib::ustring argv1;
+// original standard output in server mode, which carries only the job results
+FILE* jobResults = nullptr;
 //bool simpleEditor;
 //Glib::Threads::Thread* mainThread;
 
@@ -88,6 +106,219 @@ Glib::ustring fname_to_utf8 (const char* fname)
 
 bool fast_export = false;
 
+// Rough upper bound of the memory needed by processImage() per pixel of the input image
+// (raw data, demosaiced planes, working Imagefloat and LabImage buffers)
+constexpr std::size_t bytesPerPixelEstimate = 64;
+
+/* Bounds the estimated working set of the images processed concurrently by the -J option.
+ * An image larger than the whole budget is still processed, but only when nothing else is in flight. */
+class MemoryBudget :
+    public rtengine::NonCopyable
+{
+public:
+    explicit MemoryBudget (std::size_t limit) :
+        limit (limit),
+        used (0)
+    {
+    }
+
+    void acquire (std::size_t bytes)
+    {
+        Glib::Threads::Mutex::Lock lock (mutex);
+
+        while (limit > 0 && used > 0 && used + bytes > limit) {
+            released.wait (mutex);
+        }
+
+        used += bytes;
+    }
+
+    void release (std::size_t bytes)
+    {
+        Glib::Threads::Mutex::Lock lock (mutex);
+        used -= bytes;
+        released.broadcast ();
+    }
+
+private:
+    const std::size_t limit;
+    std::size_t used;
+    Glib::Threads::Mutex mutex;
+    Glib::Threads::Cond released;
+};
+
+/* Console output of one image. When several images are processed at once, the messages
+ * are buffered and written in one go, so that the output of concurrent jobs doesn't interleave. */
+class JobLog :
+    public rtengine::NonCopyable
+{
+public:
+    JobLog (bool buffered, std::ostream& console) :
+        buffered (buffered),
+        console (console)
+    {
+    }
+
+    ~JobLog ()
+    {
+        if (buffered) {
+            static Glib::Threads::Mutex consoleMutex;
+            Glib::Threads::Mutex::Lock lock (consoleMutex);
+            console << outBuffer.str() << std::flush;
+            std::cerr << errBuffer.str() << std::flush;
+        }
+    }
+
+    std::ostream& out ()
+    {
+        return buffered ? static_cast<std::ostream&> (outBuffer) : console;
+    }
+
+    std::ostream& err ()
+    {
+        return buffered ? static_cast<std::ostream&> (errBuffer) : std::cerr;
+    }
+
+    std::string getErrors () const
+    {
+        return errBuffer.str();
+    }
+
+private:
+    const bool buffered;
+    std::ostream& console;
+    std::ostringstream outBuffer;
+    std::ostringstream errBuffer;
+};
+
+// Settings gathered from the command line, shared read-only by all the processing jobs
+struct CliSettings {
+    rtengine::procparams::PartialProfile* rawParams;
+    rtengine::procparams::PartialProfile* imgParams;
+    const std::vector<rtengine::procparams::PartialProfile*>* processingParams;
+    Glib::ustring outputPath;
+    bool outputDirectory;
+    bool leaveUntouched;
+    bool overwriteFiles;
+    bool sideProcParams;
+    bool copyParamsFile;
+    bool skipIfNoSidecar;
+    bool useDefault;
+    unsigned int sideCarFilePos;
+    int compression;
+    int subsampling;
+    int bits;
+    bool isFloat;
+    std::string outputType;
+    bool bufferedLog;
+    // in server mode the standard output is reserved for the job results
+    bool serverMode;
+};
+
+// One image travelling through the decoding, processing and encoding stages
+class CliJob :
+    public rtengine::NonCopyable
+{
+public:
+    CliJob (const Glib::ustring& inputFile, const CliSettings& settings, MemoryBudget& memoryBudget) :
+        inputFile (inputFile),
+        initialImage (nullptr),
+        resultImage (nullptr),
+        failed (false),
+        log (settings.bufferedLog, settings.serverMode ? std::cerr : std::cout),
+        memoryBudget (memoryBudget),
+        reservedMemory (0)
+    {
+    }
+
+    ~CliJob ()
+    {
+        if (initialImage) {
+            initialImage->decreaseRef();
+        }
+
+        delete resultImage;
+        memoryBudget.release (reservedMemory);
+    }
+
+    void reserveMemory (std::size_t bytes)
+    {
+        memoryBudget.acquire (bytes);
+        reservedMemory += bytes;
+    }
+
+    const Glib::ustring inputFile;
+    Glib::ustring outputFile;
+    // Has to be reinstanciated at each profile to have a ProcParams object with default values
+    rtengine::procparams::ProcParams params;
+    rtengine::InitialImage* initialImage;
+    rtengine::IImagefloat* resultImage;
+    bool failed;
+    JobLog log;
+
+private:
+    MemoryBudget& memoryBudget;
+    std::size_t reservedMemory;
+};
+
+/* Bounded, blocking FIFO between two stages of the processing pipeline.
+ * pop() returns false once every producer is done and the queue is drained. */
+class JobQueue :
+    public rtengine::NonCopyable
+{
+public:
+    JobQueue (std::size_t capacity, int producers) :
+        capacity (capacity),
+        producers (producers)
+    {
+    }
+
+    void push (std::unique_ptr<CliJob> job)
+    {
+        Glib::Threads::Mutex::Lock lock (mutex);
+
+        while (jobs.size() >= capacity) {
+            notFull.wait (mutex);
+        }
+
+        jobs.push_back (std::move (job));
+        notEmpty.signal ();
+    }
+
+    bool pop (std::unique_ptr<CliJob>& job)
+    {
+        Glib::Threads::Mutex::Lock lock (mutex);
+
+        while (jobs.empty() && producers > 0) {
+            notEmpty.wait (mutex);
+        }
+
+        if (jobs.empty()) {
+            return false;
+        }
+
+        job = std::move (jobs.front());
+        jobs.pop_front();
+        notFull.signal ();
+        return true;
+    }
+
+    void producerDone ()
+    {
+        Glib::Threads::Mutex::Lock lock (mutex);
+        --producers;
+        notEmpty.broadcast ();
+    }
+
+private:
+    const std::size_t capacity;
+    int producers;
+    std::deque<std::unique_ptr<CliJob>> jobs;
+    Glib::Threads::Mutex mutex;
+    Glib::Threads::Cond notEmpty;
+    Glib::Threads::Cond notFull;
+};
+
 }
 
 /* Process line command options
@@ -102,6 +333,10 @@ int processLineParams ( int argc, char **argv );
 
 bool dontLoadCache ( int argc, char **argv );
 
+bool readJobsFromStdin ( int argc, char **argv );
+
+FILE* reserveStdout ();
+
 int main (int argc, char **argv)
 {
     setlocale (LC_ALL, "");
@@ -109,6 +344,17 @@ int main (int argc, char **argv)
 
     Gio::init ();
 
+    // In server mode the standard output carries only the job results. The engine prints its messages to
+    // stdout too, so before it is initialized they are moved to stderr and the results get their own stream.
+    if (readJobsFromStdin (argc, argv)) {
+        jobResults = reserveStdout ();
+
+        if (!jobResults) {
+            std::cerr << "Error: the standard output could not be reserved for the job results." << std::endl;
+            return -2;
+        }
+    }
+
     //mainThread = Glib::Threads::Thread::self();
 
 #ifdef BUILD_BUNDLE
@@ -167,6 +413,10 @@ int main (int argc, char **argv)
         return -2;
     }
 
+    // The buffers kept by the pool would not be counted in the memory budget of the concurrent jobs
+    // and each job flushes its raw data anyway, so the command line tool doesn't keep any
+    rtengine::setBufferPoolCapacity (0);
+
     if (options.is_defProfRawMissing()) {
         options.defProfRaw = DEFPROFILE_RAW;
         std::cerr << std::endl
@@ -251,6 +501,576 @@ bool dontLoadCache ( int argc, char **argv )
     return false;
 }
 
+bool readJobsFromStdin ( int argc, char **argv )
+{
+    for (int iArg = 1; iArg < argc; iArg++) {
+        Glib::ustring currParam (argv[iArg]);
+#if ECLIPSE_ARGS
+        currParam = currParam.substr (1, currParam.length() - 2);
+#endif
+        if ( currParam.length() > 1 && currParam.at(0) == '-' ) {
+            if ( currParam.at(1) == 'i' ) {
+                return true;
+            } else if ( currParam.at(1) == 'c' ) {
+                // the remaining arguments are input files
+                break;
+            }
+        }
+    }
+
+    return false;
+}
+
+/* Redirects the standard output to stderr and returns a stream on the original standard output,
+ * nullptr on failure */
+FILE* reserveStdout ()
+{
+    std::cout.flush();
+    fflush (stdout);
+#ifdef WIN32
+    const int fd = _dup (_fileno (stdout));
+
+    if (fd < 0 || _dup2 (_fileno (stderr), _fileno (stdout)) < 0) {
+        return nullptr;
+    }
+
+    return _fdopen (fd, "w");
+#else
+    const int fd = dup (STDOUT_FILENO);
+
+    if (fd < 0 || dup2 (STDERR_FILENO, STDOUT_FILENO) < 0) {
+        return nullptr;
+    }
+
+    return fdopen (fd, "w");
+#endif
+}
+
+/* Decoding stage: checks the output file, loads the image and builds its processing parameters
+ * Returns false if the image is skipped or if an error occurred */
+bool loadFile (const CliSettings& settings, CliJob& job)
+{
+    const Glib::ustring& inputFile = job.inputFile;
+
+    job.log.out() << "Output is " << settings.bits << "-bit " << (settings.isFloat ? "floating-point" : "integer") << "." << std::endl;
+    job.log.out() << "Processing: " << inputFile << std::endl;
+
+    int errorCode;
+    bool isRaw = false;
+
+    if ( settings.outputPath.empty() ) {
+        Glib::ustring s = inputFile;
+        Glib::ustring::size_type ext = s.find_last_of ('.');
+        job.outputFile = s.substr (0, ext) + "." + settings.outputType;
+    } else if ( settings.outputDirectory ) {
+        Glib::ustring s = Glib::path_get_basename ( inputFile );
+        Glib::ustring::size_type ext = s.find_last_of ('.');
+        job.outputFile = Glib::build_filename (settings.outputPath, s.substr (0, ext) + "." + settings.outputType);
+    } else {
+        if (settings.leaveUntouched) {
+            job.outputFile = settings.outputPath;
+        } else {
+            Glib::ustring s = settings.outputPath;
+            Glib::ustring::size_type ext = s.find_last_of ('.');
+            job.outputFile = s.substr (0, ext) + "." + settings.outputType;
+        }
+    }
+
+    if ( inputFile == job.outputFile) {
+        job.log.err() << "Cannot overwrite: " << inputFile << std::endl;
+        return false;
+    }
+
+    if ( !settings.overwriteFiles && Glib::file_test ( job.outputFile, Glib::FILE_TEST_EXISTS ) ) {
+        job.log.err() << job.outputFile  << " already exists: use -Y option to overwrite. This image has been skipped." << std::endl;
+        return false;
+    }
+
+    // Load the image
+    isRaw = true;
+    Glib::ustring ext = getExtension (inputFile);
+
+    if (ext.lowercase() == "jpg" || ext.lowercase() == "jpeg" || ext.lowercase() == "tif" || ext.lowercase() == "tiff" || ext.lowercase() == "png") {
+        isRaw = false;
+    }
+
+    rtengine::InitialImage* ii = rtengine::InitialImage::load ( inputFile, isRaw, &errorCode, nullptr );
+
+    if (!ii) {
+        job.failed = true;
+        job.log.err() << "Error loading file: " << inputFile << std::endl;
+        return false;
+    }
+
+    if (settings.useDefault) {
+        const bool dynamic = (isRaw ? options.defProfRaw : options.defProfImg) == DEFPROFILE_DYNAMIC;
+        rtengine::procparams::PartialProfile* defaultParams = isRaw ? settings.rawParams : settings.imgParams;
+
+        if (dynamic) {
+            defaultParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
+        }
+
+        job.log.out() << (isRaw ? "  Merging default raw processing profile." : "  Merging default non-raw processing profile.") << std::endl;
+        defaultParams->applyTo (&job.params);
+
+        if (dynamic) {
+            defaultParams->deleteInstance();
+            delete defaultParams;
+        }
+    }
+
+    bool sideCarFound = false;
+    unsigned int i = 0;
+
+    // Iterate the procparams file list in order to build the final ProcParams
+    do {
+        if (settings.sideProcParams && i == settings.sideCarFilePos) {
+            // using the sidecar file
+            Glib::ustring sideProcessingParams = inputFile + paramFileExtension;
+
+            // the "load" method don't reset the procparams values anymore, so values found in the procparam file override the one of currentParams
+            if ( !Glib::file_test ( sideProcessingParams, Glib::FILE_TEST_EXISTS ) || job.params.load ( sideProcessingParams )) {
+                job.log.err() << "Warning: sidecar file requested but not found for: " << sideProcessingParams << std::endl;
+            } else {
+                sideCarFound = true;
+                job.log.out() << "  Merging sidecar procparams." << std::endl;
+            }
+        }
+
+        if ( settings.processingParams->size() > i  ) {
+            job.log.out() << "  Merging procparams #" << i << std::endl;
+            (*settings.processingParams)[i]->applyTo (&job.params);
+        }
+
+        i++;
+    } while (i < settings.processingParams->size() + (settings.sideProcParams ? 1 : 0));
+
+    if ( settings.sideProcParams && !sideCarFound && settings.skipIfNoSidecar ) {
+        delete ii;
+        job.failed = true;
+        job.log.err() << "Error: no sidecar procparams found for: " << inputFile << std::endl;
+        return false;
+    }
+
+    int fullW = 0, fullH = 0;
+    ii->getImageSource()->getFullSize (fullW, fullH);
+    job.reserveMemory (static_cast<std::size_t> (fullW) * fullH * bytesPerPixelEstimate);
+
+    job.initialImage = ii;
+    return true;
+}
+
+/* Processing stage
+ * Returns false if an error occurred */
+bool developFile (CliJob& job)
+{
+    int errorCode;
+    rtengine::ProcessingJob* processingJob = rtengine::ProcessingJob::create (job.initialImage, job.params, fast_export);
+
+    if ( !processingJob ) {
+        job.failed = true;
+        job.log.err() << "Error creating processing for: " << job.inputFile << std::endl;
+        job.initialImage->decreaseRef();
+        job.initialImage = nullptr;
+        return false;
+    }
+
+    // the image source belongs to this job alone, so its raw data and demosaiced planes can be
+    // freed as soon as the working image has been built, like the batch queue of the GUI does
+    job.resultImage = rtengine::processImage (processingJob, errorCode, nullptr, true);
+
+    if ( !job.resultImage ) {
+        job.failed = true;
+        job.log.err() << "Error processing: " << job.inputFile << std::endl;
+        rtengine::ProcessingJob::destroy ( processingJob );
+        job.initialImage = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+/* Encoding stage: saves the result to disk */
+void saveFile (const CliSettings& settings, CliJob& job)
+{
+    int errorCode;
+
+    if ( settings.outputType == "jpg" ) {
+        errorCode = job.resultImage->saveAsJPEG ( job.outputFile, settings.compression, settings.subsampling );
+    } else if ( settings.outputType == "tif" ) {
+        errorCode = job.resultImage->saveAsTIFF ( job.outputFile, settings.bits, settings.isFloat, settings.compression == 0  );
+    } else if ( settings.outputType == "png" ) {
+        errorCode = job.resultImage->saveAsPNG ( job.outputFile, settings.bits );
+    } else {
+        errorCode = job.resultImage->saveToFile (job.outputFile);
+    }
+
+    if (errorCode) {
+        job.failed = true;
+        job.log.err() << "Error saving to: " << job.outputFile << std::endl;
+    } else {
+        if ( settings.copyParamsFile ) {
+            Glib::ustring outputProcessingParams = job.outputFile + paramFileExtension;
+            job.params.save ( outputProcessingParams );
+        }
+    }
+}
+
+/* Processes the input files of the command line
+ * Returns -2 if an error occurred for at least one image, 0 otherwise */
+int processFiles (const CliSettings& settings, const std::vector<Glib::ustring>& inputFiles, int jobs, std::size_t memoryBudget)
+{
+    jobs = std::min<int> (jobs, inputFiles.size());
+
+#ifdef _OPENMP
+    // split the OpenMP threads between the images processed concurrently
+    const int threadsPerJob = std::max (1, omp_get_max_threads() / jobs);
+#endif
+
+    // The images are decoded, processed and encoded by a three-stage pipeline, so that
+    // reading the next image and writing the previous one are hidden behind the processing.
+    MemoryBudget budget (memoryBudget);
+    // the raw decoders are reentrant, but decoding is mostly bound by the file access and the
+    // single-threaded entropy decoding, so use up to one decoder per two processing workers
+    const int decoders = std::max (1, jobs / 2);
+    JobQueue decodedJobs (jobs, decoders);
+    JobQueue developedJobs (jobs, jobs);
+    std::atomic<unsigned> errors (0);
+
+    const auto dropJob =
+        [&errors](std::unique_ptr<CliJob>& job)
+        {
+            if (job->failed) {
+                ++errors;
+            }
+
+            job.reset();
+        };
+
+    std::atomic<std::size_t> nextInput (0);
+
+    const auto decode =
+        [&]()
+        {
+#ifdef _OPENMP
+            if (decoders > 1) {
+                omp_set_num_threads (threadsPerJob);
+            }
+#endif
+            for (std::size_t i = nextInput++; i < inputFiles.size(); i = nextInput++) {
+                std::unique_ptr<CliJob> job (new CliJob (inputFiles[i], settings, budget));
+
+                if (loadFile (settings, *job)) {
+                    decodedJobs.push (std::move (job));
+                } else {
+                    dropJob (job);
+                }
+            }
+
+            decodedJobs.producerDone();
+        };
+
+    const auto develop =
+        [&]()
+        {
+#ifdef _OPENMP
+            if (jobs > 1) {
+                omp_set_num_threads (threadsPerJob);
+            }
+#endif
+            std::unique_ptr<CliJob> job;
+
+            while (decodedJobs.pop (job)) {
+                if (developFile (*job)) {
+                    developedJobs.push (std::move (job));
+                } else {
+                    dropJob (job);
+                }
+            }
+
+            developedJobs.producerDone();
+        };
+
+    std::vector<Glib::Threads::Thread*> threads;
+
+    for (int i = 0; i < decoders; ++i) {
+        threads.push_back (Glib::Threads::Thread::create (decode));
+    }
+
+    for (int i = 0; i < jobs; ++i) {
+        threads.push_back (Glib::Threads::Thread::create (develop));
+    }
+
+    // the encoding stage runs in the main thread
+    std::unique_ptr<CliJob> job;
+
+    while (developedJobs.pop (job)) {
+        saveFile (settings, *job);
+        dropJob (job);
+    }
+
+    for (auto thread : threads) {
+        thread->join();
+    }
+
+    return errors > 0 ? -2 : 0;
+}
+
+/* Reads the settings of a job of the server mode, on top of those of the command line
+ * Returns an error message, or an empty string if the job is valid */
+std::string parseJob (const cJSON* root, CliSettings& settings, Glib::ustring& inputFile, std::vector<rtengine::procparams::PartialProfile*>& jobParams)
+{
+    if (!cJSON_IsObject (root)) {
+        return "the job is not a JSON object";
+    }
+
+    std::string error;
+
+    const auto getString =
+        [root, &error](const char* name, Glib::ustring& value)
+        {
+            const cJSON* const item = cJSON_GetObjectItemCaseSensitive (root, name);
+
+            if (item && !cJSON_IsString (item)) {
+                error = std::string ("\"") + name + "\" has to be a string";
+            } else if (item) {
+                value = item->valuestring;
+            }
+
+            return item != nullptr;
+        };
+
+    const auto getInt =
+        [root, &error](const char* name, int minValue, int maxValue, int& value)
+        {
+            const cJSON* const item = cJSON_GetObjectItemCaseSensitive (root, name);
+
+            if (item && (!cJSON_IsNumber (item) || item->valuedouble < minValue || item->valuedouble > maxValue)) {
+                error = std::string ("\"") + name + "\" has to be a number in the [" + std::to_string (minValue) + "-" + std::to_string (maxValue) + "] range";
+            } else if (item) {
+                value = item->valueint;
+            }
+
+            return item != nullptr;
+        };
+
+    const auto getBool =
+        [root, &error](const char* name, bool& value)
+        {
+            const cJSON* const item = cJSON_GetObjectItemCaseSensitive (root, name);
+
+            if (item && !cJSON_IsBool (item)) {
+                error = std::string ("\"") + name + "\" has to be true or false";
+            } else if (item) {
+                value = cJSON_IsTrue (item);
+            }
+
+            return item != nullptr;
+        };
+
+    if (!getString ("input", inputFile) && error.empty()) {
+        return "\"input\" is missing";
+    }
+
+    if (!error.empty()) {
+        return error;
+    }
+
+    if (!Glib::file_test (inputFile, Glib::FILE_TEST_IS_REGULAR)) {
+        return "\"" + inputFile.raw() + "\" doesn't exist";
+    }
+
+    if (getString ("output", settings.outputPath)) {
+        settings.outputDirectory = Glib::file_test (settings.outputPath, Glib::FILE_TEST_IS_DIR);
+        settings.leaveUntouched = false;
+    }
+
+    Glib::ustring format;
+
+    if (getString ("format", format)) {
+        // same defaults as -j, -t and -n
+        if (format == "jpg") {
+            settings.compression = 92;
+            settings.bits = 8;
+        } else if (format == "tif") {
+            settings.compression = 0;
+            settings.bits = 16;
+        } else if (format == "png") {
+            settings.compression = -1;
+            settings.bits = 8;
+        } else if (error.empty()) {
+            error = "\"format\" has to be one of jpg, tif or png";
+        }
+
+        settings.outputType = format.raw();
+        settings.isFloat = false;
+    }
+
+    bool compress = false;
+
+    if (settings.outputType == "jpg") {
+        getInt ("quality", 0, 100, settings.compression);
+        getInt ("subsampling", 1, 3, settings.subsampling);
+    } else if (settings.outputType == "tif" && getBool ("compress", compress)) {
+        settings.compression = compress ? 1 : 0;
+    }
+
+    getInt ("bits", 8, 32, settings.bits);
+    getBool ("float", settings.isFloat);
+
+    if (settings.bits == 32) {
+        settings.isFloat = true;
+    } else if (settings.bits != 8 && settings.bits != 16 && error.empty()) {
+        error = "\"bits\" has to be 8, 16 or 32";
+    }
+
+    getBool ("overwrite", settings.overwriteFiles);
+
+    if (!error.empty()) {
+        return error;
+    }
+
+    if (const cJSON* const profiles = cJSON_GetObjectItemCaseSensitive (root, "profiles")) {
+        if (!cJSON_IsArray (profiles)) {
+            return "\"profiles\" has to be an array of file names";
+        }
+
+        const cJSON* profile;
+        cJSON_ArrayForEach (profile, profiles) {
+            if (!cJSON_IsString (profile)) {
+                return "\"profiles\" has to be an array of file names";
+            }
+
+            rtengine::procparams::PartialProfile* const currentParams = new rtengine::procparams::PartialProfile (true);
+            jobParams.push_back (currentParams);
+
+            if (currentParams->load (profile->valuestring)) {
+                return std::string ("\"") + profile->valuestring + "\" not found";
+            }
+        }
+    }
+
+    bool sideProcParams = false;
+
+    if (getBool ("sidecar", sideProcParams)) {
+        // the sidecar file is merged last, like -s after all the -p options
+        settings.sideProcParams = sideProcParams;
+        settings.sideCarFilePos = settings.processingParams->size() + jobParams.size();
+    }
+
+    return error;
+}
+
+/* Runs one job of the server mode and adds its result to response
+ * Returns false if the job failed */
+bool runJob (const CliSettings& defaults, const std::string& request, MemoryBudget& budget, cJSON* response)
+{
+    MyTime startTime;
+    startTime.set();
+
+    cJSON* const root = cJSON_Parse (request.c_str());
+    CliSettings settings = defaults;
+    Glib::ustring inputFile;
+    std::vector<rtengine::procparams::PartialProfile*> jobParams;
+    const std::string error = root ? parseJob (root, settings, inputFile, jobParams) : "invalid JSON";
+
+    // lets the client match the results to its requests
+    if (const cJSON* const id = cJSON_IsObject (root) ? cJSON_GetObjectItemCaseSensitive (root, "id") : nullptr) {
+        cJSON_AddItemToObject (response, "id", cJSON_Duplicate (id, true));
+    }
+
+    cJSON_Delete (root);
+
+    if (!error.empty()) {
+        deleteProcParams (jobParams);
+        cJSON_AddStringToObject (response, "status", "error");
+        cJSON_AddStringToObject (response, "message", error.c_str());
+        return false;
+    }
+
+    std::vector<rtengine::procparams::PartialProfile*> processingParams (*defaults.processingParams);
+    processingParams.insert (processingParams.end(), jobParams.begin(), jobParams.end());
+    settings.processingParams = &processingParams;
+
+    bool failed;
+
+    {
+        CliJob job (inputFile, settings, budget);
+        cJSON_AddStringToObject (response, "input", inputFile.c_str());
+
+        MyTime stageTime;
+
+        if (loadFile (settings, job)) {
+            stageTime.set();
+            cJSON_AddNumberToObject (response, "load_ms", stageTime.etime (startTime) / 1000);
+
+            if (developFile (job)) {
+                MyTime developedTime;
+                developedTime.set();
+                cJSON_AddNumberToObject (response, "process_ms", developedTime.etime (stageTime) / 1000);
+
+                saveFile (settings, job);
+                stageTime.set();
+                cJSON_AddNumberToObject (response, "save_ms", stageTime.etime (developedTime) / 1000);
+            }
+        }
+
+        if (!job.outputFile.empty()) {
+            cJSON_AddStringToObject (response, "output", job.outputFile.c_str());
+        }
+
+        failed = job.failed;
+        // loadFile() skips existing output files without failing
+        cJSON_AddStringToObject (response, "status", failed ? "error" : job.resultImage ? "ok" : "skipped");
+
+        const std::string messages = job.log.getErrors();
+
+        if (!messages.empty()) {
+            cJSON_AddStringToObject (response, "message", messages.c_str());
+        }
+    }
+
+    deleteProcParams (jobParams);
+
+    MyTime stopTime;
+    stopTime.set();
+    cJSON_AddNumberToObject (response, "total_ms", stopTime.etime (startTime) / 1000);
+
+    return !failed;
+}
+
+/* Server mode: reads the jobs from the standard input, one JSON object per line, e.g.
+ *   {"input": "photo.raw", "output": "photo.jpg", "profiles": ["one.pp3", "two.pp3"], "format": "jpg", "quality": 90}
+ * and writes the result of each job as one JSON line to the standard output. The engine stays initialized
+ * between the jobs, so only the first ones pay for loading the profiles, lens database and LUTs.
+ * Returns -2 if at least one job failed, 0 otherwise */
+int processJobs (const CliSettings& settings)
+{
+    MemoryBudget budget (0);
+    unsigned int errors = 0;
+    std::string request;
+
+    while (std::getline (std::cin, request)) {
+        if (request.find_first_not_of (" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        cJSON* const response = cJSON_CreateObject();
+
+        if (!runJob (settings, request, budget, response)) {
+            ++errors;
+        }
+
+        char* const text = cJSON_PrintUnformatted (response);
+        fprintf (jobResults, "%s\n", text);
+        fflush (jobResults);
+        cJSON_free (text);
+        cJSON_Delete (response);
+    }
+
+    return errors > 0 ? -2 : 0;
+}
+
 int processLineParams ( int argc, char **argv )
 {
     rtengine::procparams::PartialProfile *rawParams = nullptr, *imgParams = nullptr;
@@ -271,7 +1091,10 @@ int processLineParams ( int argc, char **argv )
     int bits = -1;
     bool isFloat = false;
     std::string outputType;
-    unsigned errors = 0;
+    int jobs = 1;
+    std::size_t memoryBudget = 0;
+    bool readJobs = false;
+    bool convertFiles = false;
 
     for ( int iArg = 1; iArg < argc; iArg++) {
         Glib::ustring currParam (argv[iArg]);
@@ -354,6 +1177,10 @@ int processLineParams ( int argc, char **argv )
                 case 'q':
                     break;
 
+                case 'i':
+                    readJobs = true;
+                    break;
+
                 case 'Y':
                     overwriteFiles = true;
                     break;
@@ -432,7 +1259,39 @@ int processLineParams ( int argc, char **argv )
                     fast_export = true;
                     break;
 
+                case 'J':
+                    if (iArg + 1 < argc) {
+                        iArg++;
+                        jobs = atoi (argv[iArg]);
+                    }
+
+                    if (jobs < 1) {
+                        std::cerr << "Error: the -J switch requires a number of concurrent images of at least 1!" << std::endl;
+                        deleteProcParams (processingParams);
+                        return -3;
+                    }
+
+                    break;
+
+                case 'M':
+                    if (iArg + 1 < argc) {
+                        iArg++;
+                        const int budgetMiB = atoi (argv[iArg]);
+
+                        if (budgetMiB < 0) {
+                            std::cerr << "Error: the value accompanying the -M switch can't be negative!" << std::endl;
+                            deleteProcParams (processingParams);
+                            return -3;
+                        }
+
+                        memoryBudget = static_cast<std::size_t> (budgetMiB) << 20;
+                    }
+
+                    break;
+
                 case 'c': // MUST be last option
+                    convertFiles = true;
+
                     while (iArg + 1 < argc) {
                         iArg++;
                         Glib::ustring argument (fname_to_utf8 (argv[iArg]));
@@ -538,7 +1397,7 @@ int processLineParams ( int argc, char **argv )
                     std::cout << "  " << Glib::path_get_basename (argv[0]) << " <other options> -c <dir>|<files>   Convert files in batch with your own settings." << std::endl;
                     std::cout << std::endl;
                     std::cout << "Options:" << std::endl;
-                    std::cout << "  " << Glib::path_get_basename (argv[0]) << "[-o <output>|-O <output>] [-q] [-a] [-s|-S] [-p <one.pp3> [-p <two.pp3> ...] ] [-d] [ -j[1-100] -js<1-3> | -t[z] -b<8|16|16f|32> | -n -b<8|16> ] [-Y] [-f] -c <input>" << std::endl;
+                    std::cout << "  " << Glib::path_get_basename (argv[0]) << "[-o <output>|-O <output>] [-q] [-a] [-s|-S] [-p <one.pp3> [-p <two.pp3> ...] ] [-d] [ -j[1-100] -js<1-3> | -t[z] -b<8|16|16f|32> | -n -b<8|16> ] [-Y] [-f] [-J <n>] [-M <MiB>] -c <input>|-i" << std::endl;
                     std::cout << std::endl;
                     std::cout << "  -c <files>       Specify one or more input files or folders." << std::endl;
                     std::cout << "                   When specifying folders, Rawtherapee will look for image file types which comply" << std::endl;
@@ -580,6 +1439,21 @@ int processLineParams ( int argc, char **argv )
                     std::cout << "                   Compression is hard-coded to PNG_FILTER_PAETH, Z_RLE." << std::endl;
                     std::cout << "  -Y               Overwrite output if present." << std::endl;
                     std::cout << "  -f               Use the custom fast-export processing pipeline." << std::endl;
+                    std::cout << "  -J <n>           Process up to n images concurrently (default: 1)." << std::endl;
+                    std::cout << "                   The processing threads are split evenly between the images in flight." << std::endl;
+                    std::cout << "                   In all cases, the next image is read and the previous one is written" << std::endl;
+                    std::cout << "                   while the current one is being processed." << std::endl;
+                    std::cout << "  -M <MiB>         Limit the estimated memory used by the images processed concurrently" << std::endl;
+                    std::cout << "                   with -J (default: 0, no limit)." << std::endl;
+                    std::cout << "  -i               Server mode: instead of -c, read the jobs from the standard input, one JSON" << std::endl;
+                    std::cout << "                   object per line, and keep the engine initialized between them, e.g." << std::endl;
+                    std::cout << "                   {\"id\": 1, \"input\": \"photo.raw\", \"output\": \"photo.jpg\", \"profiles\": [\"one." << pparamsExt << "\"]}" << std::endl;
+                    std::cout << "                   Optional members: \"id\", \"output\", \"profiles\", \"sidecar\", \"format\" (jpg, tif or png)," << std::endl;
+                    std::cout << "                   \"quality\", \"subsampling\", \"compress\", \"bits\", \"float\" and \"overwrite\"." << std::endl;
+                    std::cout << "                   The options of the command line are the defaults of each job, the profiles" << std::endl;
+                    std::cout << "                   of a job are merged after those of the command line. The result of each job" << std::endl;
+                    std::cout << "                   is written as one JSON line to the standard output, with its status and timings." << std::endl;
+                    std::cout << "                   All other messages go to the standard error." << std::endl;
                     std::cout << std::endl;
                     std::cout << "Your " << pparamsExt << " files can be incomplete, RawTherapee will build the final values as follows:" << std::endl;
                     std::cout << "  1- A new processing profile is created using neutral values," << std::endl;
@@ -642,7 +1516,13 @@ int processLineParams ( int argc, char **argv )
         return 1;
     }
 
-    if ( inputFiles.empty() ) {
+    if ( readJobs && convertFiles ) {
+        std::cerr << "Error: the -i switch reads the input files from the jobs and can't be combined with -c." << std::endl;
+        deleteProcParams (processingParams);
+        return -1;
+    }
+
+    if ( inputFiles.empty() && !readJobs ) {
         return 2;
     }
 
@@ -672,169 +1552,35 @@ int processLineParams ( int argc, char **argv )
         }
     }
 
-    for ( size_t iFile = 0; iFile < inputFiles.size(); iFile++) {
-
-        // Has to be reinstanciated at each profile to have a ProcParams object with default values
-        rtengine::procparams::ProcParams currentParams;
-
-        Glib::ustring inputFile = inputFiles[iFile];
-        std::cout << "Output is " << bits << "-bit " << (isFloat ? "floating-point" : "integer") << "." << std::endl;
-        std::cout << "Processing: " << inputFile << std::endl;
-
-        rtengine::InitialImage* ii = nullptr;
-        rtengine::ProcessingJob* job = nullptr;
-        int errorCode;
-        bool isRaw = false;
-
-        Glib::ustring outputFile;
-
-        if ( outputType.empty() ) {
-            outputType = "jpg";
-        }
-
-        if ( outputPath.empty() ) {
-            Glib::ustring s = inputFile;
-            Glib::ustring::size_type ext = s.find_last_of ('.');
-            outputFile = s.substr (0, ext) + "." + outputType;
-        } else if ( outputDirectory ) {
-            Glib::ustring s = Glib::path_get_basename ( inputFile );
-            Glib::ustring::size_type ext = s.find_last_of ('.');
-            outputFile = Glib::build_filename (outputPath, s.substr (0, ext) + "." + outputType);
-        } else {
-            if (leaveUntouched) {
-                outputFile = outputPath;
-            } else {
-                Glib::ustring s = outputPath;
-                Glib::ustring::size_type ext = s.find_last_of ('.');
-                outputFile = s.substr (0, ext) + "." + outputType;
-            }
-        }
-
-        if ( inputFile == outputFile) {
-            std::cerr << "Cannot overwrite: " << inputFile << std::endl;
-            continue;
-        }
-
-        if ( !overwriteFiles && Glib::file_test ( outputFile, Glib::FILE_TEST_EXISTS ) ) {
-            std::cerr << outputFile  << " already exists: use -Y option to overwrite. This image has been skipped." << std::endl;
-            continue;
-        }
-
-        // Load the image
-        isRaw = true;
-        Glib::ustring ext = getExtension (inputFile);
-
-        if (ext.lowercase() == "jpg" || ext.lowercase() == "jpeg" || ext.lowercase() == "tif" || ext.lowercase() == "tiff" || ext.lowercase() == "png") {
-            isRaw = false;
-        }
-
-        ii = rtengine::InitialImage::load ( inputFile, isRaw, &errorCode, nullptr );
-
-        if (!ii) {
-            errors++;
-            std::cerr << "Error loading file: " << inputFile << std::endl;
-            continue;
-        }
-
-        if (useDefault) {
-            if (isRaw) {
-                if (options.defProfRaw == DEFPROFILE_DYNAMIC) {
-                    rawParams->deleteInstance();
-                    delete rawParams;
-                    rawParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
-                }
-
-                std::cout << "  Merging default raw processing profile." << std::endl;
-                rawParams->applyTo (&currentParams);
-            } else {
-                if (options.defProfImg == DEFPROFILE_DYNAMIC) {
-                    imgParams->deleteInstance();
-                    delete imgParams;
-                    imgParams = ProfileStore::getInstance()->loadDynamicProfile (ii->getMetaData());
-                }
-
-                std::cout << "  Merging default non-raw processing profile." << std::endl;
-                imgParams->applyTo (&currentParams);
-            }
-        }
-
-        bool sideCarFound = false;
-        unsigned int i = 0;
-
-        // Iterate the procparams file list in order to build the final ProcParams
-        do {
-            if (sideProcParams && i == sideCarFilePos) {
-                // using the sidecar file
-                Glib::ustring sideProcessingParams = inputFile + paramFileExtension;
-
-                // the "load" method don't reset the procparams values anymore, so values found in the procparam file override the one of currentParams
-                if ( !Glib::file_test ( sideProcessingParams, Glib::FILE_TEST_EXISTS ) || currentParams.load ( sideProcessingParams )) {
-                    std::cerr << "Warning: sidecar file requested but not found for: " << sideProcessingParams << std::endl;
-                } else {
-                    sideCarFound = true;
-                    std::cout << "  Merging sidecar procparams." << std::endl;
-                }
-            }
-
-            if ( processingParams.size() > i  ) {
-                std::cout << "  Merging procparams #" << i << std::endl;
-                processingParams[i]->applyTo (&currentParams);
-            }
-
-            i++;
-        } while (i < processingParams.size() + (sideProcParams ? 1 : 0));
-
-        if ( sideProcParams && !sideCarFound && skipIfNoSidecar ) {
-            delete ii;
-            errors++;
-            std::cerr << "Error: no sidecar procparams found for: " << inputFile << std::endl;
-            continue;
-        }
-
-        job = rtengine::ProcessingJob::create (ii, currentParams, fast_export);
-
-        if ( !job ) {
-            errors++;
-            std::cerr << "Error creating processing for: " << inputFile << std::endl;
-            ii->decreaseRef();
-            continue;
-        }
-
-        // Process image
-        rtengine::IImagefloat* resultImage = rtengine::processImage (job, errorCode, nullptr);
-
-        if ( !resultImage ) {
-            errors++;
-            std::cerr << "Error processing: " << inputFile << std::endl;
-            rtengine::ProcessingJob::destroy ( job );
-            continue;
-        }
-
-        // save image to disk
-        if ( outputType == "jpg" ) {
-            errorCode = resultImage->saveAsJPEG ( outputFile, compression, subsampling );
-        } else if ( outputType == "tif" ) {
-            errorCode = resultImage->saveAsTIFF ( outputFile, bits, isFloat, compression == 0  );
-        } else if ( outputType == "png" ) {
-            errorCode = resultImage->saveAsPNG ( outputFile, bits );
-        } else {
-            errorCode = resultImage->saveToFile (outputFile);
-        }
-
-        if (errorCode) {
-            errors++;
-            std::cerr << "Error saving to: " << outputFile << std::endl;
-        } else {
-            if ( copyParamsFile ) {
-                Glib::ustring outputProcessingParams = outputFile + paramFileExtension;
-                currentParams.save ( outputProcessingParams );
-            }
-        }
-
-        ii->decreaseRef();
-        delete resultImage;
+    if ( outputType.empty() ) {
+        outputType = "jpg";
     }
 
+    CliSettings settings;
+    settings.rawParams = rawParams;
+    settings.imgParams = imgParams;
+    settings.processingParams = &processingParams;
+    settings.outputPath = outputPath;
+    settings.outputDirectory = outputDirectory;
+    settings.leaveUntouched = leaveUntouched;
+    settings.overwriteFiles = overwriteFiles;
+    settings.sideProcParams = sideProcParams;
+    settings.copyParamsFile = copyParamsFile;
+    settings.skipIfNoSidecar = skipIfNoSidecar;
+    settings.useDefault = useDefault;
+    settings.sideCarFilePos = sideCarFilePos;
+    settings.compression = compression;
+    settings.subsampling = subsampling;
+    settings.bits = bits;
+    settings.isFloat = isFloat;
+    settings.outputType = outputType;
+
+    settings.serverMode = readJobs;
+    // the stages overlap as soon as there is more than one image, in server mode the buffered errors are part of the results
+    settings.bufferedLog = readJobs || inputFiles.size() > 1;
+
+    const int ret = readJobs ? processJobs (settings) : processFiles (settings, inputFiles, jobs, memoryBudget);
+
     if (imgParams) {
         imgParams->deleteInstance();
         delete imgParams;
@@ -847,5 +1593,5 @@ int processLineParams ( int argc, char **argv )
 
     deleteProcParams (processingParams);
 
-    return errors > 0 ? -2 : 0;
+    return ret;
 }
@@ -468,6 +468,10 @@ void Options::setDefaults()
 #else
     clutCacheSize = 1;
 #endif
+    demosaicCacheSize = 0;
+    templateCacheSize = 1024;
+    bufferPoolSize = 512;
+    exportTileSize = 0;
     filledProfile = false;
     maxInspectorBuffers = 2; //  a rather conservative value for low specced systems...
     inspectorDelay = 0;
@@ -1169,6 +1173,23 @@ void Options::readFromFile(Glib::ustring fname)
                     clutCacheSize = keyFile.get_integer("Performance", "ClutCacheSize");
                 }
 
+                if (keyFile.has_key("Performance", "DemosaicCacheSize")) {
+                    demosaicCacheSize = std::max(0, keyFile.get_integer("Performance", "DemosaicCacheSize"));
+                }
+
+                if (keyFile.has_key("Performance", "TemplateCacheSize")) {
+                    templateCacheSize = std::max(0, keyFile.get_integer("Performance", "TemplateCacheSize"));
+                }
+
+                if (keyFile.has_key("Performance", "BufferPoolSize")) {
+                    bufferPoolSize = std::max(0, keyFile.get_integer("Performance", "BufferPoolSize"));
+                }
+
+                if (keyFile.has_key("Performance", "ExportTileSize")) {
+                    const int tileSize = keyFile.get_integer("Performance", "ExportTileSize");
+                    exportTileSize = tileSize > 0 ? std::max(256, tileSize) : 0;
+                }
+
                 if (keyFile.has_key("Performance", "MaxInspectorBuffers")) {
                     maxInspectorBuffers = keyFile.get_integer("Performance", "MaxInspectorBuffers");
                 }
@@ -2205,6 +2226,10 @@ void Options::saveToFile(Glib::ustring fname)
 
         keyFile.set_integer("Performance", "RgbDenoiseThreadLimit", rgbDenoiseThreadLimit);
         keyFile.set_integer("Performance", "ClutCacheSize", clutCacheSize);
+        keyFile.set_integer("Performance", "DemosaicCacheSize", demosaicCacheSize);
+        keyFile.set_integer("Performance", "TemplateCacheSize", templateCacheSize);
+        keyFile.set_integer("Performance", "BufferPoolSize", bufferPoolSize);
+        keyFile.set_integer("Performance", "ExportTileSize", exportTileSize);
         keyFile.set_integer("Performance", "MaxInspectorBuffers", maxInspectorBuffers);
         keyFile.set_integer("Performance", "InspectorDelay", inspectorDelay);
         keyFile.set_integer("Performance", "PreviewDemosaicFromSidecar", prevdemo);
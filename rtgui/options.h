@@ -356,6 +356,10 @@ public:
     int maxInspectorBuffers;   // maximum number of buffers (i.e. images) for the Inspector feature
     int inspectorDelay;
     int clutCacheSize;
+    int demosaicCacheSize; // size limit of the on disk cache of demosaiced raw images in MiB ; 0 = disabled
+    int templateCacheSize; // size limit of the on disk cache of averaged dark frame and flat field templates in MiB ; 0 = disabled
+    int bufferPoolSize; // size limit of the freed image buffers kept for reuse in MiB ; 0 = disabled
+    int exportTileSize; // size in pixels of the tiles of the tiled export pipeline ; 0 = disabled
     bool filledProfile;  // Used as reminder for the ProfilePanel "mode"
     prevdemo_t prevdemo; // Demosaicing method used for the <100% preview
     bool serializeTiffRead;
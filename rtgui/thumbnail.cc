@@ -792,7 +792,12 @@ ThFileType Thumbnail::getType () const
 
 int Thumbnail::infoFromImage (const Glib::ustring& fname, std::unique_ptr<rtengine::RawMetaDataLocation> rml)
 {
-    rtengine::FramesMetaData* idata = rtengine::FramesMetaData::fromFile (fname, std::move(rml));
+    // for raw files, try to get away without parsing the whole metadata
+    rtengine::FramesMetaData* idata = rml ? rtengine::FramesMetaData::fromFileQuick (fname) : nullptr;
+
+    if (!idata) {
+        idata = rtengine::FramesMetaData::fromFile (fname, std::move(rml));
+    }
 
     if (!idata) {
         return 0;
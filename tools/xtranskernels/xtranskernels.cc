@@ -0,0 +1,172 @@
+/*
+ *  This file is part of RawTherapee.
+ *
+ *  RawTherapee is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RawTherapee is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RawTherapee.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Runs the SSE2 and the scalar variants of the X-Trans demosaic kernels on a fixed tile,
+// prints their timing and exits with 1 if they don't give bit identical results.
+//
+// usage: xtranskernels [runs]
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "xtrans_kernels.h"
+
+using rtengine::xtrans::ts;
+
+namespace
+{
+
+double elapsedMs(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Results {
+    std::vector<float> drv;
+    std::vector<float> rgbOut[2][3]; // 4 and 8 directions
+    double derivativesTime;
+    double averageTime[2];
+};
+
+template<bool vectorized>
+Results runKernels(const float (*rgb)[ts][ts][3], const float (*yuv)[ts - 8][ts - 8], const uint8_t (*homosum)[ts][ts], const uint8_t (*const homosummax[2])[ts], const int f[4], int runs)
+{
+    Results results;
+    results.drv.assign(4 * (ts - 10) * (ts - 10), 0.f);
+    const auto drv = reinterpret_cast<float (*)[ts - 10][ts - 10]>(results.drv.data());
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int run = 0; run < runs; ++run) {
+        for (int d = 0; d < 4; ++d) {
+            rtengine::xtrans::xtransYuvDerivatives<vectorized>(yuv, drv[d], f[d], ts, ts);
+        }
+    }
+
+    results.derivativesTime = elapsedMs(start);
+
+    // the 1-pass and the 3-pass variants use 4 and 8 directions
+    for (int ndir = 4, i = 0; ndir <= 8; ndir += 4, ++i) {
+        float* rows[3][ts];
+
+        for (int c = 0; c < 3; ++c) {
+            results.rgbOut[i][c].assign(ts * ts, 0.f);
+
+            for (int row = 0; row < ts; ++row) {
+                rows[c][row] = &results.rgbOut[i][c][row * ts];
+            }
+        }
+
+        start = std::chrono::steady_clock::now();
+
+        for (int run = 0; run < runs; ++run) {
+            rtengine::xtrans::xtransAverageHomogeneous<vectorized>(rgb, homosum, homosummax[i], ndir, 8, 8, ts, ts, rows[0], rows[1], rows[2], 0, 0);
+        }
+
+        results.averageTime[i] = elapsedMs(start);
+    }
+
+    return results;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+#ifndef __SSE2__
+    std::cout << "Built without SSE2, there is nothing to compare" << std::endl;
+    return 0;
+#else
+    const int runs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 100;
+
+    std::vector<float> rgbBuffer(8 * ts * ts * 3);
+    std::vector<float> yuvBuffer(3 * (ts - 8) * (ts - 8));
+    std::vector<uint8_t> homosumBuffer(8 * ts * ts);
+    std::vector<uint8_t> homosummaxBuffer[2] = {std::vector<uint8_t>(ts * ts), std::vector<uint8_t>(ts * ts)};
+    const auto rgb = reinterpret_cast<const float (*)[ts][ts][3]>(rgbBuffer.data());
+    const auto yuv = reinterpret_cast<const float (*)[ts - 8][ts - 8]>(yuvBuffer.data());
+    const auto homosum = reinterpret_cast<const uint8_t (*)[ts][ts]>(homosumBuffer.data());
+    const uint8_t (*const homosummax[2])[ts] = {
+        reinterpret_cast<const uint8_t (*)[ts]>(homosummaxBuffer[0].data()),
+        reinterpret_cast<const uint8_t (*)[ts]>(homosummaxBuffer[1].data())
+    };
+
+    // fixed pseudo random tile. The homogeneity sums are small to get many ties between the directions
+    // and some rgb values are negative, as the interpolated values can be.
+    uint32_t seed = 12345;
+    const auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    };
+
+    for (auto &value : rgbBuffer) {
+        value = static_cast<float>(next() % 65536) - 1024.f;
+    }
+
+    for (auto &value : yuvBuffer) {
+        value = static_cast<float>(next() % 65536) / 65535.f;
+    }
+
+    for (auto &value : homosumBuffer) {
+        value = next() % 32;
+    }
+
+    // as in xtrans_interpolate, the threshold of the homogeneity sums is computed from the directions which are averaged
+    for (int ndir = 4, k = 0; ndir <= 8; ndir += 4, ++k) {
+        for (int i = 0; i < ts * ts; ++i) {
+            uint8_t maxval = 0;
+
+            for (int d = 0; d < ndir; ++d) {
+                maxval = std::max(maxval, homosumBuffer[d * ts * ts + i]);
+            }
+
+            homosummaxBuffer[k][i] = maxval - (maxval >> 3);
+        }
+    }
+
+    const int f[4] = { 1, ts - 8, ts - 7, ts - 9 }; // the offsets used by xtrans_interpolate
+
+    const Results scalar = runKernels<false>(rgb, yuv, homosum, homosummax, f, runs);
+    const Results sse2 = runKernels<true>(rgb, yuv, homosum, homosummax, f, runs);
+
+    const bool derivativesIdentical = !memcmp(scalar.drv.data(), sse2.drv.data(), scalar.drv.size() * sizeof(float));
+    bool averageIdentical[2];
+
+    for (int i = 0; i < 2; ++i) {
+        averageIdentical[i] = true;
+
+        for (int c = 0; c < 3; ++c) {
+            averageIdentical[i] = averageIdentical[i] && !memcmp(scalar.rgbOut[i][c].data(), sse2.rgbOut[i][c].data(), ts * ts * sizeof(float));
+        }
+    }
+
+    const auto status = [](bool identical) {
+        return identical ? "identical" : "DIFFER";
+    };
+
+    std::cout << "X-Trans demosaic kernels on a fixed " << ts << "x" << ts << " tile, " << runs << " runs (scalar / SSE2):" << std::endl;
+    std::cout << "  YPbPr derivatives:       " << scalar.derivativesTime << " ms / " << sse2.derivativesTime << " ms, " << status(derivativesIdentical) << std::endl;
+    std::cout << "  averaging, 4 directions: " << scalar.averageTime[0] << " ms / " << sse2.averageTime[0] << " ms, " << status(averageIdentical[0]) << std::endl;
+    std::cout << "  averaging, 8 directions: " << scalar.averageTime[1] << " ms / " << sse2.averageTime[1] << " ms, " << status(averageIdentical[1]) << std::endl;
+
+    return derivativesIdentical && averageIdentical[0] && averageIdentical[1] ? 0 : 1;
+#endif
+}